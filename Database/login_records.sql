@@ -0,0 +1,21 @@
+-- Tables written behind by the Authentication Server (see DataBase.RecordLogin), in the schema of the users table.
+-- Create them on every shard.
+
+-- One row per user, upserted on every successful login, so `login` must be the primary key.
+CREATE TABLE IF NOT EXISTS last_logins (
+    login VARCHAR(255) NOT NULL,
+    time DATETIME NOT NULL,
+    ip VARCHAR(45) NOT NULL,
+    PRIMARY KEY (login)
+);
+
+-- One row per answered login attempt, `status` is AuthPacketCodec.AuthStatus. Rate limited attempts are not recorded.
+CREATE TABLE IF NOT EXISTS auth_audit (
+    id BIGINT UNSIGNED NOT NULL AUTO_INCREMENT,
+    login VARCHAR(255) NOT NULL,
+    time DATETIME NOT NULL,
+    ip VARCHAR(45) NOT NULL,
+    status TINYINT UNSIGNED NOT NULL,
+    PRIMARY KEY (id),
+    KEY login_time (login, time)
+);
@@ -1,15 +1,18 @@
 #include "mysql.h"
+#include "mysql_shards.h"
 
 extern "C" void GDN_EXPORT godot_gdnative_init(godot_gdnative_init_options *o) {
-    godot::Godot::gdnative_init(o);
+	godot::Godot::gdnative_init(o);
 }
 
 extern "C" void GDN_EXPORT godot_gdnative_terminate(godot_gdnative_terminate_options *o) {
-    godot::Godot::gdnative_terminate(o);
+	godot::Godot::gdnative_terminate(o);
 }
 
 extern "C" void GDN_EXPORT godot_nativescript_init(void *handle) {
-    godot::Godot::nativescript_init(handle);
+	godot::Godot::nativescript_init(handle);
 
-    godot::register_class<godot::MySQL>();
+	godot::register_class<godot::MySQL>();
+	godot::register_class<godot::MySQLRequest>();
+	godot::register_class<godot::MySQLShards>();
 }
\ No newline at end of file
@@ -3,13 +3,8 @@
 #include <cppconn/prepared_statement.h>
 #include <cppconn/statement.h>
 
-#define QUEUE_TASK(p_task)      \
-{                               \
-	QueueItem item;             \
-	item.task = p_task;         \
-	item.user_data = user_data; \
-	item_queue.push(item);      \
-}
+#include <algorithm>
+#include <thread>
 
 #define LOCK() mutex->lock()
 
@@ -21,59 +16,168 @@ semaphore->post()
 
 #define PRINT_SQL_ERROR(p_e) ERR_PRINT(String(e.what()) + ". MySQL error code: " + String::num_int64(e.getErrorCode()) + ". SQLState: " + e.getSQLStateCStr())
 
-#define CALL(p_func_ref) 
-
 using namespace godot;
 
 
-void MySQL::_connect_to_database(Object *p_target, const String &p_callback, const Array &p_args) {
-    bool success = false;
+bool MySQL::_connect_worker(Worker *p_worker) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-    LOCK();
+	LOCK();
+	sql::ConnectOptionsMap properties = connection_properties;
+	std::vector<String> statements;
+	p_worker->schema = schema;
+
+	// Write-behind worker only runs its own inserts, hot statements are for the pool.
+	if (p_worker->write_behind) {
+		properties["CLIENT_COMPRESS"] = write_behind_compression;
+	} else {
+		statements = hot_statements;
+	}
+	UNLOCK();
 
-    try {
-		driver = sql::mysql::get_mysql_driver_instance();
+	try {
+		p_worker->connection.reset(driver->connect(properties));
+	} catch (sql::SQLException &e) {
+		PRINT_SQL_ERROR(e);
+		p_worker->connected = false;
+		return false;
+	}
 
-		connection.reset(driver->connect(connection_properties));
+	p_worker->connected = true;
+	p_worker->check_connection = false;
+	p_worker->last_used = std::chrono::steady_clock::now();
 
-		success = true;
-    } catch(sql::SQLException &e) {
-        PRINT_SQL_ERROR(e);
-    }
+	Godot::print("MySQL: connection " + String::num_int64(p_worker->index) + " opened in " + String::num_int64(_msec_since(start)) + " ms.");
 
-    _call_function(p_target, p_callback, success, p_args);
+	_prepare_hot_statements(p_worker, statements);
 
-    UNLOCK();
+	return true;
 }
 
-void MySQL::_set_schema(const String &p_schema, Object *p_target, const String &p_callback, const Array &p_args) {
-	bool success = false;
+void MySQL::_prepare_hot_statements(Worker *p_worker, const std::vector<String> &p_statements) {
+	if (p_statements.empty()) {
+		return;
+	}
 
-	LOCK();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-	try {
-		if (_is_connected_to_database()) {
-			connection_properties["schema"] = p_schema.utf8().get_data();
-			connection->setSchema(godot_string_to_sql(p_schema));
-			success = true;
+	for (const String &query : p_statements) {
+		try {
+			p_worker->prepared_statements[query.utf8().get_data()].reset(p_worker->connection->prepareStatement(godot_string_to_sql(query)));
+		} catch (sql::SQLException &e) {
+			PRINT_SQL_ERROR(e);
 		}
-	} catch (sql::SQLException &e) {
-		PRINT_SQL_ERROR(e);
+	}
+
+	Godot::print("MySQL: connection " + String::num_int64(p_worker->index) + " prepared " + String::num_int64(p_worker->prepared_statements.size()) + " statements in " + String::num_int64(_msec_since(start)) + " ms.");
+}
+
+// Prepared statements die with the connection they were prepared on, so a lost connection is
+// replaced by a new one and the hot statements are prepared again on it.
+bool MySQL::_reconnect_worker(Worker *p_worker) {
+	_close_connection(p_worker);
+
+	return _connect_worker(p_worker);
+}
 
+// Sleeps in short steps, so a worker waiting to reconnect still exits promptly.
+void MySQL::_sleep_unless_exit(int64_t p_msec) {
+	for (int64_t slept = 0; slept < p_msec && !exit; slept += 50) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
 	}
-	_call_function(p_target, p_callback, success, p_args);
+}
+
+// Must be called with the mutex locked.
+// Tasks can't wait for a connection no worker has, so they fail once the last one is gone.
+void MySQL::_count_connected_workers(int p_delta) {
+	connected_workers += p_delta;
 
+	if (connected_workers == 0 && connect_reported && !exit) {
+		_complete_queued_tasks(MySQLRequest::FAILED);
+	}
+}
+
+// Tells every worker to close its connection and exit, `_join_workers` waits for them.
+void MySQL::_stop_workers() {
+	LOCK();
+	exit = true;
+	_complete_queued_tasks(MySQLRequest::CANCELLED);
 	UNLOCK();
+
+	for (size_t i = 0; i < workers.size(); i++) {
+		semaphore->post();
+	}
+
+	// Write-behind worker flushes whatever is still buffered before it exits.
+	{
+		std::lock_guard<std::mutex> lock(write_behind_mutex);
+		write_behind_exit = true;
+	}
+	write_behind_condition.notify_one();
 }
 
-void MySQL::_execute_query(const String &p_query, Object *p_target, const String &p_callback, const Array &p_args) {
-	bool success = false;
+// Must be called after `_stop_workers`, from the thread that owns the MySQL object.
+void MySQL::_join_workers() {
+	// Every worker closes its own connection on the way out.
+	for (size_t i = 0; i < workers.size(); i++) {
+		workers[i]->thread->wait_to_finish();
+	}
+
+	if (write_behind_worker) {
+		write_behind_worker->thread->wait_to_finish();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(write_behind_mutex);
+		write_behind_worker.reset();
+		write_behind_exit = false;
+	}
 
 	LOCK();
-	
+	workers.clear();
+	connected_workers = 0;
+	exit = false;
+	UNLOCK();
+}
+
+// Must be called with the mutex locked.
+void MySQL::_report_connection(bool p_success) {
+	pending_connections--;
+
+	if (connect_reported || (!p_success && pending_connections > 0)) {
+		return;
+	}
+
+	connect_reported = true;
+
+	if (p_success) {
+		Godot::print("MySQL: first connection ready " + String::num_int64(_msec_since(connect_start)) + " ms after connect_to_database.");
+	}
+
+	connect_request->complete(p_success ? MySQLRequest::OK : MySQLRequest::FAILED);
+	connect_request.unref();
+}
+
+void MySQL::_set_schema(Worker *p_worker, const String &p_schema, const Ref<MySQLRequest> &p_request) {
+	LOCK();
+	schema = p_schema;
+	connection_properties["schema"] = p_schema.utf8().get_data();
+	UNLOCK();
+
+	// Other workers pick the new schema up before their next task.
+	_sync_schema(p_worker);
+
+	bool success = p_worker->schema == p_schema;
+
+	p_request->complete(success ? MySQLRequest::OK : MySQLRequest::FAILED);
+}
+
+void MySQL::_execute_query(Worker *p_worker, const String &p_query, const Ref<MySQLRequest> &p_request) {
+	bool success = false;
+
 	try {
-		if (_is_connected_to_database()) {
-			std::unique_ptr<sql::Statement> statement(connection->createStatement());
+		if (_is_connected_to_database(p_worker)) {
+			std::unique_ptr<sql::Statement> statement(p_worker->connection->createStatement());
 			statement->execute(godot_string_to_sql(p_query));
 
 			success = true;
@@ -82,19 +186,16 @@ void MySQL::_execute_query(const String &p_query, Object *p_target, const String
 		PRINT_SQL_ERROR(e);
 	}
 
-	_call_function(p_target, p_callback, success, p_args);
-
-    UNLOCK();
+	p_request->complete(success ? MySQLRequest::OK : MySQLRequest::FAILED);
 }
 
-void MySQL::_execute_prepared_query(const String &p_query, const Array &p_params, Object *p_target, const String &p_callback, const Array &p_args) {
+void MySQL::_execute_prepared_query(Worker *p_worker, const String &p_query, const Array &p_params, const Ref<MySQLRequest> &p_request) {
 	bool success = false;
 
-	LOCK();
-	
 	try {
-		if (_is_connected_to_database()) {
-			std::unique_ptr<sql::PreparedStatement> prepared_statement(connection->prepareStatement(godot_string_to_sql(p_query)));
+		if (_is_connected_to_database(p_worker)) {
+			std::unique_ptr<sql::PreparedStatement> owned_statement;
+			sql::PreparedStatement *prepared_statement = _get_prepared_statement(p_worker, p_query, &owned_statement);
 			_prepare_statement(prepared_statement, p_params);
 
 			prepared_statement->execute();
@@ -105,20 +206,16 @@ void MySQL::_execute_prepared_query(const String &p_query, const Array &p_params
 		PRINT_SQL_ERROR(e);
 	}
 
-	_call_function(p_target, p_callback, success, p_args);
-
-	UNLOCK();
+	p_request->complete(success ? MySQLRequest::OK : MySQLRequest::FAILED);
 }
 
-void MySQL::_execute_update_query(const String &p_query, Object *p_target, const String &p_callback, const Array &p_args) {
+void MySQL::_execute_update_query(Worker *p_worker, const String &p_query, const Ref<MySQLRequest> &p_request) {
 	bool success = false;
 	int rows = 0;
 
-	LOCK();
-	
 	try {
-		if (_is_connected_to_database()) {
-			std::unique_ptr<sql::Statement> statement(connection->createStatement());
+		if (_is_connected_to_database(p_worker)) {
+			std::unique_ptr<sql::Statement> statement(p_worker->connection->createStatement());
 			rows = statement->executeUpdate(godot_string_to_sql(p_query));
 			success = true;
 		}
@@ -126,20 +223,17 @@ void MySQL::_execute_update_query(const String &p_query, Object *p_target, const
 		PRINT_SQL_ERROR(e);
 	}
 
-	_call_function(p_target, p_callback, success, rows, p_args);
-
-	UNLOCK();
+	p_request->complete(success ? MySQLRequest::OK : MySQLRequest::FAILED, rows);
 }
 
-void MySQL::_execute_prepared_update_query(const String &p_query, const Array &p_params, Object *p_target, const String &p_callback, const Array &p_args) {
+void MySQL::_execute_prepared_update_query(Worker *p_worker, const String &p_query, const Array &p_params, const Ref<MySQLRequest> &p_request) {
 	bool success = false;
 	int rows = 0;
 
-	LOCK();
-	
 	try {
-		if (_is_connected_to_database()) {
-			std::unique_ptr<sql::PreparedStatement> prepared_statement(connection->prepareStatement(godot_string_to_sql(p_query)));
+		if (_is_connected_to_database(p_worker)) {
+			std::unique_ptr<sql::PreparedStatement> owned_statement;
+			sql::PreparedStatement *prepared_statement = _get_prepared_statement(p_worker, p_query, &owned_statement);
 			_prepare_statement(prepared_statement, p_params);
 			rows = prepared_statement->executeUpdate();
 			success = true;
@@ -148,20 +242,16 @@ void MySQL::_execute_prepared_update_query(const String &p_query, const Array &p
 		PRINT_SQL_ERROR(e);
 	}
 
-	_call_function(p_target, p_callback, success, rows, p_args);
-
-	UNLOCK();
+	p_request->complete(success ? MySQLRequest::OK : MySQLRequest::FAILED, rows);
 }
 
-void MySQL::_execute_select_query(const String &p_query, Object *p_target, const String &p_callback, const Array &p_args) {
+void MySQL::_execute_select_query(Worker *p_worker, const String &p_query, const Ref<MySQLRequest> &p_request) {
 	bool success = false;
 	size_t rows = 0;
 
-	LOCK();
-
 	try {
-		if (_is_connected_to_database()) {
-			std::unique_ptr<sql::Statement> statement(connection->createStatement());
+		if (_is_connected_to_database(p_worker)) {
+			std::unique_ptr<sql::Statement> statement(p_worker->connection->createStatement());
 			std::unique_ptr<sql::ResultSet> result_set(statement->executeQuery(godot_string_to_sql(p_query)));
 			
 			rows = result_set->rowsCount();
@@ -171,20 +261,17 @@ void MySQL::_execute_select_query(const String &p_query, Object *p_target, const
 		PRINT_SQL_ERROR(e);
 	}
 
-	_call_function(p_target, p_callback, success, p_args);
-
-	UNLOCK();
+	p_request->complete(success ? MySQLRequest::OK : MySQLRequest::FAILED, rows);
 }
 
-void MySQL::_execute_prepared_select_query(const String &p_query, const Array &p_params, Object *p_target, const String &p_callback, const Array &p_args) {
+void MySQL::_execute_prepared_select_query(Worker *p_worker, const String &p_query, const Array &p_params, const Ref<MySQLRequest> &p_request) {
 	bool success = false;
 	size_t rows = 0;
 
-	LOCK();
-
 	try {
-		if (_is_connected_to_database()) {
-			std::unique_ptr<sql::PreparedStatement> prepared_statement(connection->prepareStatement(godot_string_to_sql(p_query)));
+		if (_is_connected_to_database(p_worker)) {
+			std::unique_ptr<sql::PreparedStatement> owned_statement;
+			sql::PreparedStatement *prepared_statement = _get_prepared_statement(p_worker, p_query, &owned_statement);
 			_prepare_statement(prepared_statement, p_params);
 
 			std::unique_ptr<sql::ResultSet> result_set(prepared_statement->executeQuery());
@@ -196,20 +283,16 @@ void MySQL::_execute_prepared_select_query(const String &p_query, const Array &p
 		PRINT_SQL_ERROR(e);
 	}
 
-	_call_function(p_target, p_callback, success, rows, p_args);
-
-	UNLOCK();
+	p_request->complete(success ? MySQLRequest::OK : MySQLRequest::FAILED, rows);
 }
 
-void MySQL::_fetch_array(const String &p_query, Object *p_target, const String &p_callback, const Array &p_args) {
+void MySQL::_fetch_array(Worker *p_worker, const String &p_query, const Ref<MySQLRequest> &p_request) {
 	bool success = false;
 	Array result_array;
 
-	LOCK();
-	
 	try {
-		if (_is_connected_to_database()) {
-			std::unique_ptr<sql::Statement> statement(connection->createStatement());
+		if (_is_connected_to_database(p_worker)) {
+			std::unique_ptr<sql::Statement> statement(p_worker->connection->createStatement());
 			std::unique_ptr<sql::ResultSet> result_set(statement->executeQuery(godot_string_to_sql(p_query)));
 			_process_result_set_as_array(result_set, &result_array);
 
@@ -219,20 +302,17 @@ void MySQL::_fetch_array(const String &p_query, Object *p_target, const String &
 		PRINT_SQL_ERROR(e);
 	}
 
-	_call_function(p_target, p_callback, success, result_array, p_args);
-
-	UNLOCK();
+	p_request->complete(success ? MySQLRequest::OK : MySQLRequest::FAILED, result_array.size(), result_array);
 }
 
-void MySQL::_fetch_prepared_array(const String &p_query, const Array &p_params, Object *p_target, const String &p_callback, const Array &p_args) {
+void MySQL::_fetch_prepared_array(Worker *p_worker, const String &p_query, const Array &p_params, const Ref<MySQLRequest> &p_request) {
 	bool success = false;
 	Array result_array;
 
-	LOCK();
-	
 	try {
-		if (_is_connected_to_database()) {
-			std::unique_ptr<sql::PreparedStatement> prepared_statement(connection->prepareStatement(godot_string_to_sql(p_query)));
+		if (_is_connected_to_database(p_worker)) {
+			std::unique_ptr<sql::PreparedStatement> owned_statement;
+			sql::PreparedStatement *prepared_statement = _get_prepared_statement(p_worker, p_query, &owned_statement);
 			_prepare_statement(prepared_statement, p_params);
 
 			std::unique_ptr<sql::ResultSet> result_set(prepared_statement->executeQuery());
@@ -244,20 +324,16 @@ void MySQL::_fetch_prepared_array(const String &p_query, const Array &p_params,
 		PRINT_SQL_ERROR(e);
 	}
 
-	_call_function(p_target, p_callback, success, result_array, p_args);
-
-	UNLOCK();
+	p_request->complete(success ? MySQLRequest::OK : MySQLRequest::FAILED, result_array.size(), result_array);
 }
 
-void MySQL::_fetch_dictionary(const String &p_query, Object *p_target, const String &p_callback, const Array &p_args) {
+void MySQL::_fetch_dictionary(Worker *p_worker, const String &p_query, const Ref<MySQLRequest> &p_request) {
 	bool success = false;
 	Array result_array;
 
-	LOCK();
-	
 	try {
-		if (_is_connected_to_database()) {
-			std::unique_ptr<sql::Statement> statement(connection->createStatement());
+		if (_is_connected_to_database(p_worker)) {
+			std::unique_ptr<sql::Statement> statement(p_worker->connection->createStatement());
 			std::unique_ptr<sql::ResultSet> result_set(statement->executeQuery(godot_string_to_sql(p_query)));
 
 			_process_result_set_as_dictionary(result_set, &result_array);
@@ -268,20 +344,17 @@ void MySQL::_fetch_dictionary(const String &p_query, Object *p_target, const Str
 		PRINT_SQL_ERROR(e);
 	}
 
-	_call_function(p_target, p_callback, success, result_array, p_args);
-
-	UNLOCK();
+	p_request->complete(success ? MySQLRequest::OK : MySQLRequest::FAILED, result_array.size(), result_array);
 }
 
-void MySQL::_fetch_prepared_dictionary(const String &p_query, const Array &p_params, Object *p_target, const String &p_callback, const Array &p_args) {
+void MySQL::_fetch_prepared_dictionary(Worker *p_worker, const String &p_query, const Array &p_params, const Ref<MySQLRequest> &p_request) {
 	bool success = false;
 	Array result_array;
 
-	LOCK();
-	
 	try {
-		if (_is_connected_to_database()) {
-			std::unique_ptr<sql::PreparedStatement> prepared_statement(connection->prepareStatement(godot_string_to_sql(p_query)));
+		if (_is_connected_to_database(p_worker)) {
+			std::unique_ptr<sql::PreparedStatement> owned_statement;
+			sql::PreparedStatement *prepared_statement = _get_prepared_statement(p_worker, p_query, &owned_statement);
 			_prepare_statement(prepared_statement, p_params);
 
 			std::unique_ptr<sql::ResultSet> result_set(prepared_statement->executeQuery());
@@ -293,33 +366,163 @@ void MySQL::_fetch_prepared_dictionary(const String &p_query, const Array &p_par
 		PRINT_SQL_ERROR(e);
 	}
 	
-	_call_function(p_target, p_callback, success, result_array, p_args);
+	p_request->complete(success ? MySQLRequest::OK : MySQLRequest::FAILED, result_array.size(), result_array);
+}
 
-	UNLOCK();
+// Threads of the pool are joined by the next connect_to_database, a worker can't join itself.
+void MySQL::_close_connection(Worker *p_worker, const Ref<MySQLRequest> &p_request) {
+	// Wake the other workers up so they close their connections too.
+	_stop_workers();
+
+	_close_connection(p_worker);
+
+	p_request->complete(MySQLRequest::OK);
 }
 
-void MySQL::_close_connection(Object *p_target, const String &p_callback, const Array &p_args) {
-	_close_connection();
+void MySQL::_close_connection(Worker *p_worker) {
+	p_worker->connected = false;
 
-	LOCK();
+	// Statements have to go before the connection they were prepared on.
+	p_worker->prepared_statements.clear();
+
+	if (p_worker->connection.get() && !p_worker->connection->isClosed()) {
+		p_worker->connection->close();
+	}
+}
+
+bool MySQL::_is_connected_to_database(Worker *p_worker) {
+	// isValid() pings the server, doing it before every task would add a round trip to each of them.
+	// Connection is checked only after a task failed or when it idled long enough to be dropped by the server.
+	if (p_worker->connected && !p_worker->check_connection && _msec_since(p_worker->last_used) < CONNECTION_CHECK_IDLE_MSEC) {
+		p_worker->last_used = std::chrono::steady_clock::now();
+		return true;
+	}
+
+	if (p_worker->connected && p_worker->connection->isValid()) {
+		p_worker->check_connection = false;
+		p_worker->last_used = std::chrono::steady_clock::now();
+		return true;
+	}
 
-	_call_function(p_target, p_callback, p_args);
+	// Reconnect only when the connection is gone, each reconnect is a full (TLS) handshake.
+	return _reconnect_worker(p_worker);
+}
 
+void MySQL::_sync_schema(Worker *p_worker) {
+	LOCK();
+	String current_schema = schema;
 	UNLOCK();
+
+	if (current_schema == p_worker->schema) {
+		return;
+	}
+
+	try {
+		if (_is_connected_to_database(p_worker)) {
+			p_worker->connection->setSchema(godot_string_to_sql(current_schema));
+			p_worker->schema = current_schema;
+		}
+	} catch (sql::SQLException &e) {
+		PRINT_SQL_ERROR(e);
+	}
 }
 
-void MySQL::_close_connection() {
+sql::PreparedStatement *MySQL::_get_prepared_statement(Worker *p_worker, const String &p_query, std::unique_ptr<sql::PreparedStatement> *p_owned) {
+	std::unordered_map<std::string, std::unique_ptr<sql::PreparedStatement>>::iterator it = p_worker->prepared_statements.find(p_query.utf8().get_data());
+
+	if (it != p_worker->prepared_statements.end()) {
+		it->second->clearParameters();
+		return it->second.get();
+	}
+
+	p_owned->reset(p_worker->connection->prepareStatement(godot_string_to_sql(p_query)));
+	return p_owned->get();
+}
+
+// Must be called with the mutex locked.
+int64_t MySQL::_sample_trace_id(int64_t p_trace_id) {
+	if (p_trace_id < 0 || trace_sampling <= 0 || p_trace_id % trace_sampling != 0) {
+		return -1;
+	}
+
+	return p_trace_id;
+}
+
+// Refused tasks complete with BUSY right away, before the caller gets the request.
+// So do tasks of a connected pool that has no connection left, with FAILED.
+Ref<MySQLRequest> MySQL::_queue_task(Task p_task, const String &p_query, const Array &p_params) {
+	Ref<MySQLRequest> request;
+	request.instance();
+
+	// Taken even if the task is refused, so it never carries over to the next task.
+	int64_t trace_id = next_trace_id;
+	next_trace_id = -1;
+
 	LOCK();
 
-	if (connection.get() && !connection->isClosed()) {
-		connection->close();
+	if (!workers.empty() && !exit && connect_reported && connected_workers == 0) {
+		UNLOCK();
+
+		request->complete(MySQLRequest::FAILED);
+		return request;
 	}
 
-	UNLOCK();
+	// Schema changes and closing the connection are never shed.
+	bool sheddable = p_task != Task::SET_SCHEMA && p_task != Task::CLOSE_CONNECTION;
+
+	if (sheddable && ((queue_limit > 0 && item_queue.size() >= (size_t)queue_limit) || (admission_policy == ADMISSION_CODEL && codel_shedding))) {
+		rejected_tasks++;
+		UNLOCK();
+
+		request->complete(MySQLRequest::BUSY);
+		return request;
+	}
+
+	QueueItem item;
+	item.task = p_task;
+	item.query = p_query;
+	item.params = p_params;
+	item.request = request;
+	item.trace_id = _sample_trace_id(trace_id);
+	item_queue.push(item);
+
+	UNLOCK_AND_POST();
+
+	return request;
+}
+
+// Must be called with the mutex locked.
+void MySQL::_complete_queued_tasks(MySQLRequest::Status p_status) {
+	while (!item_queue.empty()) {
+		Ref<MySQLRequest> request = item_queue.front().request;
+		item_queue.pop();
+
+		if (request->start()) {
+			request->complete(p_status);
+		}
+	}
+}
+
+// Must be called with the mutex locked, right after a task is taken from the queue.
+// Like CoDel, the queue is standing once every task spent more than the target in it for a whole interval.
+// Tasks are shed on admission rather than on dequeue, so the caller learns about it immediately
+// and latency of admitted tasks stays around target + interval at any load.
+void MySQL::_update_codel(int64_t p_sojourn_usec, int64_t p_now_usec) {
+	if (p_sojourn_usec < codel_target_usec || item_queue.empty()) {
+		codel_above_target_until_usec = 0;
+		codel_shedding = false;
+		return;
+	}
+
+	if (codel_above_target_until_usec == 0) {
+		codel_above_target_until_usec = p_now_usec + codel_interval_usec;
+	} else if (p_now_usec >= codel_above_target_until_usec) {
+		codel_shedding = true;
+	}
 }
 
-bool MySQL::_is_connected_to_database() const {
-	return connection.get() != nullptr && connection->isValid() && connection->reconnect();
+int64_t MySQL::_msec_since(const std::chrono::steady_clock::time_point &p_start) {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - p_start).count();
 }
 
 bool MySQL::_is_sql_datetime(const String& p_datetime) {
@@ -342,7 +545,7 @@ bool MySQL::_is_sql_datetime(const String& p_datetime) {
 	return false;
 }
 
-void MySQL::_prepare_statement(const std::unique_ptr<sql::PreparedStatement> &p_prepared_statement, const Array &p_params) {
+void MySQL::_prepare_statement(sql::PreparedStatement *p_prepared_statement, const Array &p_params) {
 	for (int32_t i = 0; i < p_params.size(); i++) {
 		switch (p_params[i].get_type()) {
 			case Variant::Type::NIL: {
@@ -372,6 +575,8 @@ void MySQL::_prepare_statement(const std::unique_ptr<sql::PreparedStatement> &p_
 }
 
 void MySQL::_process_result_set_as_dictionary(const std::unique_ptr<sql::ResultSet> &p_result_set, Array *p_result_array) {
+	TraceScope span("db_decode");
+
 	sql::ResultSetMetaData *result_meta_data = p_result_set->getMetaData();
 
 	while (p_result_set->next()) {
@@ -407,6 +612,8 @@ void MySQL::_process_result_set_as_dictionary(const std::unique_ptr<sql::ResultS
 }
 
 void MySQL::_process_result_set_as_array(const std::unique_ptr<sql::ResultSet> &p_result_set, Array *p_result_array) {
+	TraceScope span("db_decode");
+
 	sql::ResultSetMetaData *result_meta_data = p_result_set->getMetaData();
 
 	while (p_result_set->next()) {
@@ -441,111 +648,299 @@ void MySQL::_process_result_set_as_array(const std::unique_ptr<sql::ResultSet> &
 	}
 }
 
-void MySQL::_thread() {
+void MySQL::_thread(Worker *p_worker) {
+	driver->threadInit();
+	TraceContext::ring = &p_worker->trace;
+
+	bool connected = _connect_worker(p_worker);
+
+	LOCK();
+	_report_connection(connected);
+	_count_connected_workers(connected ? 1 : 0);
+	UNLOCK();
+
+	int64_t backoff_msec = RECONNECT_MIN_MSEC;
+
 	while (!exit) {
+		// Worker without a connection leaves the queue to the others and keeps trying in the meantime.
+		if (!connected) {
+			_sleep_unless_exit(backoff_msec);
+			if (exit) {
+				break;
+			}
+
+			connected = _reconnect_worker(p_worker);
+
+			if (connected) {
+				backoff_msec = RECONNECT_MIN_MSEC;
+
+				LOCK();
+				_count_connected_workers(1);
+				UNLOCK();
+			} else {
+				backoff_msec = std::min(backoff_msec * 2, (int64_t)RECONNECT_MAX_MSEC);
+			}
+			continue;
+		}
+
 		semaphore->wait();
 		LOCK();
 
-		if (item_queue.size()) {
+		if (!exit && item_queue.size()) {
 			QueueItem item = item_queue.front();
 			item_queue.pop();
+
+			int64_t queued_usec = item.request->get_queued_usec();
+			int64_t now_usec = TraceRing::now_usec();
+			_update_codel(now_usec - queued_usec, now_usec);
 			UNLOCK();
 
-			switch (item.task) {
-				case Task::CONNECT_TO_DATABSE: {
+			// Cancelled while queued, it has already completed.
+			if (!item.request->start()) {
+				continue;
+			}
 
-					if (item.user_data.size() == 3) {
-						_connect_to_database(item.user_data[0], item.user_data[1], item.user_data[2]);
-					}
-				} break;
-				case Task::SET_SCHEMA: {
+			TraceContext::trace_id = item.trace_id;
+			if (item.trace_id >= 0) {
+				p_worker->trace.push("db_queue", item.trace_id, queued_usec, now_usec - queued_usec);
+			}
 
-					if (item.user_data.size() == 4) {
-						_set_schema(item.user_data[0], item.user_data[1], item.user_data[2], item.user_data[3]);
-					}
+			TraceScope task_span("db_task");
+
+			_sync_schema(p_worker);
+
+			switch (item.task) {
+				case Task::SET_SCHEMA: {
+					_set_schema(p_worker, item.query, item.request);
 				} break;
 				case Task::EXECUTE_QUERY: {
-
-					if (item.user_data.size() == 4) {
-						_execute_query(item.user_data[0], item.user_data[1], item.user_data[2], item.user_data[3]);
-					}
+					_execute_query(p_worker, item.query, item.request);
 				} break;
 				case Task::EXECUTE_PREPARED_QUERY: {
-
-					if (item.user_data.size() == 5) {
-						_execute_prepared_query(item.user_data[0], item.user_data[1], item.user_data[2], item.user_data[3], item.user_data[4]);
-					}
+					_execute_prepared_query(p_worker, item.query, item.params, item.request);
 				} break;
 				case Task::EXECUTE_UPDATE_QUERY: {
-
-					if (item.user_data.size() == 4) {
-						_execute_update_query(item.user_data[0], item.user_data[1], item.user_data[2], item.user_data[3]);
-					}
+					_execute_update_query(p_worker, item.query, item.request);
 				} break;
 				case Task::EXECUTE_PREPARED_UPDATE_QUERY: {
-
-					if (item.user_data.size() == 5) {
-						_execute_prepared_update_query(item.user_data[0], item.user_data[1], item.user_data[2], item.user_data[3], item.user_data[4]);
-					}
+					_execute_prepared_update_query(p_worker, item.query, item.params, item.request);
 				} break;
 				case Task::EXECUTE_SELECT_QUERY: {
-
-					if (item.user_data.size() == 4) {
-						_execute_select_query(item.user_data[0], item.user_data[1], item.user_data[2], item.user_data[3]);
-					}
+					_execute_select_query(p_worker, item.query, item.request);
 				} break;
 				case Task::EXECUTE_PREPARED_SELECT_QUERY: {
-
-					if (item.user_data.size() == 5) {
-						_execute_prepared_select_query(item.user_data[0], item.user_data[1], item.user_data[2], item.user_data[3], item.user_data[4]);
-					}
+					_execute_prepared_select_query(p_worker, item.query, item.params, item.request);
 				} break;
 				case Task::FETCH_ARRAY: {
-
-					if (item.user_data.size() == 4) {
-						_fetch_array(item.user_data[0], item.user_data[1], item.user_data[2], item.user_data[3]);
-					}
+					_fetch_array(p_worker, item.query, item.request);
 				} break;
 				case Task::FETCH_PREPARED_ARRAY: {
-
-					if (item.user_data.size() == 5) {
-						_fetch_prepared_array(item.user_data[0], item.user_data[1], item.user_data[2], item.user_data[3], item.user_data[4]);
-					}
+					_fetch_prepared_array(p_worker, item.query, item.params, item.request);
 				} break;
 				case Task::FETCH_DICTIONARY: {
-
-					if (item.user_data.size() == 4) {
-						_fetch_dictionary(item.user_data[0], item.user_data[1], item.user_data[2], item.user_data[3]);
-					}
+					_fetch_dictionary(p_worker, item.query, item.request);
 				} break;
 				case Task::FETCH_PREPARED_DICTIONARY: {
-
-					if (item.user_data.size() == 5) {
-						_fetch_prepared_dictionary(item.user_data[0], item.user_data[1], item.user_data[2], item.user_data[3], item.user_data[4]);
-					}
+					_fetch_prepared_dictionary(p_worker, item.query, item.params, item.request);
 				} break;
 				case Task::CLOSE_CONNECTION: {
-
-					if (item.user_data.size() == 3) {
-						_close_connection(item.user_data[0], item.user_data[1], item.user_data[2]);
-					}
+					_close_connection(p_worker, item.request);
 				} break;
 				default: {
+					item.request->complete(MySQLRequest::FAILED);
 				} break;
 			}
+
+			// Failure may have been a lost connection, which the next task checks before it runs.
+			if (item.request->get_status() == MySQLRequest::FAILED) {
+				p_worker->check_connection = true;
+			}
+
+			// Reconnecting failed, the worker backs off until it gets a connection again.
+			if (!p_worker->connected && !exit) {
+				connected = false;
+
+				LOCK();
+				_count_connected_workers(-1);
+				UNLOCK();
+			}
 		} else {
 			UNLOCK();
 		}
 	}
+
+	if (connected) {
+		LOCK();
+		connected_workers--;
+		UNLOCK();
+	}
+
+	_close_connection(p_worker);
+
+	driver->threadEnd();
+}
+
+void MySQL::_write_behind_thread(Worker *p_worker) {
+	driver->threadInit();
+
+	// Failing here is fine, every flush with rows to write reconnects.
+	_connect_worker(p_worker);
+
+	std::unique_lock<std::mutex> lock(write_behind_mutex);
+
+	while (true) {
+		write_behind_condition.wait_for(lock, std::chrono::milliseconds(write_behind_interval_msec), [this] {
+			return write_behind_flush_requested || write_behind_exit;
+		});
+
+		bool exiting = write_behind_exit;
+		write_behind_flush_requested = false;
+
+		// Take the rows out, so callers keep appending (or registering tables) while they are written.
+		std::vector<WriteBehindTable> batches(write_behind_tables.size());
+		for (size_t i = 0; i < write_behind_tables.size(); i++) {
+			batches[i].insert = write_behind_tables[i].insert;
+			batches[i].suffix = write_behind_tables[i].suffix;
+			batches[i].columns = write_behind_tables[i].columns;
+			batches[i].rows.swap(write_behind_tables[i].rows);
+		}
+
+		lock.unlock();
+
+		std::vector<size_t> written(batches.size());
+		for (size_t i = 0; i < batches.size(); i++) {
+			written[i] = _flush_write_behind(p_worker, batches[i]);
+		}
+
+		lock.lock();
+
+		// Rows left over while the connection is down go back in front of the ones buffered meanwhile.
+		int64_t kept = 0;
+		int64_t dropped = 0;
+		for (size_t i = 0; i < batches.size(); i++) {
+			std::deque<Array> &rows = write_behind_tables[i].rows;
+			rows.insert(rows.begin(), batches[i].rows.begin() + written[i], batches[i].rows.end());
+
+			// Oldest rows go first, a newer last login supersedes them anyway.
+			if ((int)rows.size() > write_behind_max_buffered) {
+				size_t excess = rows.size() - write_behind_max_buffered;
+				rows.erase(rows.begin(), rows.begin() + excess);
+				dropped += excess;
+			}
+
+			kept += batches[i].rows.size() - written[i];
+		}
+
+		write_behind_dropped += dropped;
+
+		if (kept > 0) {
+			ERR_PRINT("MySQL: write-behind connection is down, " + String::num_int64(kept - dropped) + " rows kept for the next flush, " + String::num_int64(dropped) + " dropped.");
+		}
+
+		if (exiting) {
+			break;
+		}
+	}
+
+	int64_t buffered = 0;
+	for (const WriteBehindTable &table : write_behind_tables) {
+		buffered += table.rows.size();
+	}
+
+	lock.unlock();
+
+	// Still buffered rows are written by the worker of the next connect_to_database, if there is one.
+	if (buffered > 0) {
+		WARN_PRINT("MySQL: write-behind worker exits with " + String::num_int64(buffered) + " rows buffered.");
+	}
+
+	_close_connection(p_worker);
+
+	driver->threadEnd();
 }
 
+// Returns the number of rows handled from the start of the batch, rows after it weren't written because
+// the connection is down and are worth retrying. Statements the server refused are not retried.
+// Flush settings are fixed once the write-behind worker runs, so they are read without the lock.
+size_t MySQL::_flush_write_behind(Worker *p_worker, const WriteBehindTable &p_batch) {
+	const std::deque<Array> &rows = p_batch.rows;
+
+	if (rows.empty()) {
+		return 0;
+	}
+
+	String row = "(";
+	for (int i = 0; i < p_batch.columns; i++) {
+		row += i == 0 ? "?" : ", ?";
+	}
+	row += ")";
+
+	for (size_t first = 0; first < rows.size(); first += write_behind_max_records) {
+		size_t count = std::min(rows.size() - first, (size_t)write_behind_max_records);
+
+		String query = p_batch.insert + " " + row;
+		Array params;
+
+		for (size_t i = first; i < first + count; i++) {
+			if (i != first) {
+				query += ", " + row;
+			}
+			for (int j = 0; j < p_batch.columns; j++) {
+				params.push_back(rows[i][j]);
+			}
+		}
+
+		query += p_batch.suffix;
+
+		if (!_is_connected_to_database(p_worker)) {
+			return first;
+		}
+
+		try {
+			std::unique_ptr<sql::PreparedStatement> owned_statement;
+			sql::PreparedStatement *prepared_statement = _get_prepared_statement(p_worker, query, &owned_statement);
+			_prepare_statement(prepared_statement, params);
+
+			prepared_statement->executeUpdate();
+
+			// Full batches repeat the same statement, keep it prepared.
+			if (owned_statement && count == (size_t)write_behind_max_records) {
+				p_worker->prepared_statements[query.utf8().get_data()] = std::move(owned_statement);
+			}
+		} catch (sql::SQLException &e) {
+			PRINT_SQL_ERROR(e);
+
+			if (!p_worker->connection->isValid()) {
+				p_worker->check_connection = true;
+				return first;
+			}
+
+			ERR_PRINT("MySQL: write-behind statement failed, " + String::num_int64(count) + " rows dropped.");
+
+			std::lock_guard<std::mutex> lock(write_behind_mutex);
+			write_behind_dropped += count;
+		}
+	}
+
+	return rows.size();
+}
 
 void MySQL::_init() { 
+	mutex.instance();
+	semaphore.instance();
 }
 
 void MySQL::thread_func(const Array &p_data) {
 	MySQL *mysql = Object::cast_to<MySQL>(p_data[0]);
-	mysql->_thread();
+	int index = p_data[1];
+
+	mysql->_thread(mysql->workers[index].get());
+}
+
+void MySQL::write_behind_thread_func(const Array &p_data) {
+	MySQL *mysql = Object::cast_to<MySQL>(p_data[0]);
+
+	mysql->_write_behind_thread(mysql->write_behind_worker.get());
 }
 
 void MySQL::set_credentials(const String &p_host, const String &p_username, const String &p_password, int p_port) {
@@ -559,239 +954,465 @@ void MySQL::set_credentials(const String &p_host, const String &p_username, cons
 	UNLOCK();
 }
 
-void MySQL::connect_to_database(Object *p_target, const String &p_callback, const Array &p_args) {
-    LOCK();
+void MySQL::set_pool_size(int p_size) {
+	LOCK();
 
-    if (!thread->is_active()) {
-        Array data;
-        data.push_back(this);
-        thread->start(this, "thread_func", data);
-    }
+	if (workers.empty()) {
+		pool_size = p_size > 0 ? p_size : 1;
+	} else {
+		WARN_PRINT("Pool size can't be changed after connect_to_database.");
+	}
 
-    Array user_data;
-    user_data.push_back(p_target);
-    user_data.push_back(p_callback);
-    user_data.push_back(p_args);
-    
-    QUEUE_TASK(Task::CONNECT_TO_DATABSE);
+	UNLOCK();
+}
 
-    UNLOCK_AND_POST();
+// Set per connection group: the pool's small lookups rarely gain from it, the write-behind worker's
+// multi-row inserts do. Packets under MIN_COMPRESS_LENGTH (50 bytes) are never compressed, the
+// threshold is fixed by the client library and can't be configured.
+void MySQL::set_compression(bool p_workers, bool p_write_behind) {
+	LOCK();
+
+	connection_properties["CLIENT_COMPRESS"] = p_workers;
+	write_behind_compression = p_write_behind;
+
+	UNLOCK();
 }
 
-void MySQL::execute_query(const String &p_query, Object *p_target, const String &p_callback, const Array &p_args) {
+// The connector has no option for TLS session resumption, every (re)connect is a full handshake.
+void MySQL::set_ssl(int p_mode, const String &p_ca, const String &p_cert, const String &p_key) {
 	LOCK();
 
-	Array user_data;
-	user_data.push_back(p_query);
-	user_data.push_back(p_target);
-	user_data.push_back(p_callback);
-	user_data.push_back(p_args);
+	// Values of sql::ssl_mode, 1 disables TLS and 3 requires it.
+	connection_properties["OPT_SSL_MODE"] = p_mode;
 
-	QUEUE_TASK(Task::EXECUTE_QUERY);
+	if (!p_ca.empty()) {
+		connection_properties["sslCA"] = p_ca.utf8().get_data();
+	}
+	if (!p_cert.empty()) {
+		connection_properties["sslCert"] = p_cert.utf8().get_data();
+	}
+	if (!p_key.empty()) {
+		connection_properties["sslKey"] = p_key.utf8().get_data();
+	}
 
-    UNLOCK_AND_POST();
+	UNLOCK();
 }
 
-void MySQL::execute_prepared_query(const String &p_query, const Array &p_params, Object *p_target, const String &p_callback, const Array &p_args) {
+// Buffers of the client protocol, not of the socket: the connector doesn't expose SO_SNDBUF/SO_RCVBUF.
+void MySQL::set_protocol_buffers(int p_net_buffer_length, int p_max_allowed_packet) {
 	LOCK();
 
-	Array user_data;
-	user_data.push_back(p_query);
-	user_data.push_back(p_params);
-	user_data.push_back(p_target);
-	user_data.push_back(p_callback);
-	user_data.push_back(p_args);
+	if (p_net_buffer_length > 0) {
+		connection_properties["OPT_NET_BUFFER_LENGTH"] = p_net_buffer_length;
+	}
+	if (p_max_allowed_packet > 0) {
+		connection_properties["OPT_MAX_ALLOWED_PACKET"] = p_max_allowed_packet;
+	}
+
+	UNLOCK();
+}
+
+void MySQL::set_trace_sampling(int p_one_in) {
+	LOCK();
 
-	QUEUE_TASK(Task::EXECUTE_PREPARED_QUERY);
+	trace_sampling = p_one_in;
 
-    UNLOCK_AND_POST();
+	UNLOCK();
 }
 
-void MySQL::execute_update_query(const String &p_query, Object *p_target, const String &p_callback, const Array &p_args) {
+void MySQL::set_trace_process_id(int p_process_id) {
 	LOCK();
 
-	Array user_data;
-	user_data.push_back(p_query);
-	user_data.push_back(p_target);
-	user_data.push_back(p_callback);
-	user_data.push_back(p_args);
+	trace_process_id = p_process_id;
 
-	QUEUE_TASK(Task::EXECUTE_UPDATE_QUERY);
+	UNLOCK();
+}
 
-    UNLOCK_AND_POST();
+void MySQL::set_trace_id(int p_trace_id) {
+	next_trace_id = p_trace_id;
 }
 
-void MySQL::execute_prepared_update_query(const String &p_query, const Array &p_params, Object *p_target, const String &p_callback, const Array &p_args) {
+String MySQL::dump_trace() {
+	String json = "[";
+	bool first = true;
+
+	// Workers are replaced by connect_to_database, the rings themselves are read without the lock.
 	LOCK();
 
-	Array user_data;
-	user_data.push_back(p_query);
-	user_data.push_back(p_params);
-	user_data.push_back(p_target);
-	user_data.push_back(p_callback);
-	user_data.push_back(p_args);
+	for (size_t i = 0; i < workers.size(); i++) {
+		std::vector<TraceEvent> events;
+		workers[i]->trace.snapshot(&events);
+
+		for (const TraceEvent &event : events) {
+			if (!first) {
+				json += ",";
+			}
+			first = false;
+
+			json += String("{\"name\":\"") + event.name + "\",\"cat\":\"mysql\",\"ph\":\"X\",\"pid\":" + String::num_int64(trace_process_id) +
+					",\"tid\":" + String::num_int64(workers[i]->index + 1) +
+					",\"ts\":" + String::num_int64(event.start_usec) +
+					",\"dur\":" + String::num_int64(event.duration_usec) +
+					",\"args\":{\"id\":" + String::num_int64(event.trace_id) + "}}";
+		}
+	}
 
-	QUEUE_TASK(Task::EXECUTE_PREPARED_UPDATE_QUERY);
+	UNLOCK();
 
-    UNLOCK_AND_POST();
+	return json + "]";
 }
 
-void MySQL::execute_select_query(const String &p_query, Object *p_target, const String &p_callback, const Array &p_args) {
+void MySQL::register_hot_statement(const String &p_query) {
 	LOCK();
 
-	Array user_data;
-	user_data.push_back(p_query);
-	user_data.push_back(p_target);
-	user_data.push_back(p_callback);
-	user_data.push_back(p_args);
-
-	QUEUE_TASK(Task::EXECUTE_SELECT_QUERY);
+	hot_statements.push_back(p_query);
 
-    UNLOCK_AND_POST();
+	UNLOCK();
 }
 
-void MySQL::execute_prepared_select_query(const String &p_query, const Array &p_params, Object *p_target, const String &p_callback, const Array &p_args) {
+void MySQL::set_queue_limit(int p_limit) {
 	LOCK();
 
-	Array user_data;
-	user_data.push_back(p_query);
-	user_data.push_back(p_params);
-	user_data.push_back(p_target);
-	user_data.push_back(p_callback);
-	user_data.push_back(p_args);
+	queue_limit = p_limit > 0 ? p_limit : 0;
+
+	UNLOCK();
+}
+
+void MySQL::set_admission_policy(int p_policy, int p_target_msec, int p_interval_msec) {
+	LOCK();
 
-	QUEUE_TASK(Task::EXECUTE_PREPARED_SELECT_QUERY);
+	admission_policy = p_policy == ADMISSION_CODEL ? ADMISSION_CODEL : ADMISSION_REJECT_NEWEST;
+	codel_target_usec = (int64_t)p_target_msec * 1000;
+	codel_interval_usec = (int64_t)p_interval_msec * 1000;
+	codel_above_target_until_usec = 0;
+	codel_shedding = false;
 
-    UNLOCK_AND_POST();
+	UNLOCK();
 }
 
-void MySQL::fetch_array(const String &p_query, Object *p_target, const String &p_callback, const Array &p_args) {
+Dictionary MySQL::get_queue_stats() {
+	Dictionary stats;
+
 	LOCK();
 
-	Array user_data;
-	user_data.push_back(p_query);
-	user_data.push_back(p_target);
-	user_data.push_back(p_callback);
-	user_data.push_back(p_args);
+	stats["length"] = (int64_t)item_queue.size();
+	stats["rejected"] = rejected_tasks;
+	stats["shedding"] = admission_policy == ADMISSION_CODEL && codel_shedding;
 
-	QUEUE_TASK(Task::FETCH_ARRAY);
+	UNLOCK();
 
-    UNLOCK_AND_POST();
+	std::lock_guard<std::mutex> lock(write_behind_mutex);
+
+	int64_t buffered = 0;
+	for (const WriteBehindTable &table : write_behind_tables) {
+		buffered += table.rows.size();
+	}
+
+	stats["write_behind_buffered"] = buffered;
+	stats["write_behind_dropped"] = write_behind_dropped;
+
+	return stats;
+}
+
+// Must be called with both mutexes locked.
+// Write-behind rows get a connection of their own, logins never wait behind them.
+void MySQL::_start_write_behind() {
+	write_behind_worker.reset(new Worker());
+	write_behind_worker->index = pool_size;
+	write_behind_worker->write_behind = true;
+	write_behind_worker->thread.instance();
+
+	Array data;
+	data.push_back(this);
+	write_behind_worker->thread->start(this, "write_behind_thread_func", data);
 }
 
-void MySQL::fetch_prepared_array(const String &p_query, const Array &p_params, Object *p_target, const String &p_callback, const Array &p_args) {
+int MySQL::register_write_behind(const String &p_insert, int p_columns, const String &p_suffix) {
 	LOCK();
+	std::lock_guard<std::mutex> lock(write_behind_mutex);
+
+	// Rows are inserted as `<insert> (?, ...), (?, ...)<suffix>`, e.g. suffix " ON DUPLICATE KEY UPDATE ..." makes it an upsert.
+	WriteBehindTable table;
+	table.insert = p_insert;
+	table.suffix = p_suffix;
+	table.columns = p_columns;
+	write_behind_tables.push_back(table);
+
+	// First table registered on a connected pool, connect_to_database had nothing to start a worker for.
+	if (!write_behind_worker && !workers.empty() && !exit) {
+		_start_write_behind();
+	}
+
+	UNLOCK();
 
-	Array user_data;
-	user_data.push_back(p_query);
-	user_data.push_back(p_params);
-	user_data.push_back(p_target);
-	user_data.push_back(p_callback);
-	user_data.push_back(p_args);
+	return write_behind_tables.size() - 1;
+}
+
+void MySQL::set_write_behind_flush(int p_interval_msec, int p_max_records, int p_max_buffered) {
+	std::lock_guard<std::mutex> lock(write_behind_mutex);
 
-	QUEUE_TASK(Task::FETCH_PREPARED_ARRAY);
+	if (write_behind_worker) {
+		WARN_PRINT("Write-behind flush can't be changed after connect_to_database.");
+		return;
+	}
 
-    UNLOCK_AND_POST();
+	write_behind_interval_msec = p_interval_msec > 0 ? p_interval_msec : 1;
+	write_behind_max_records = p_max_records > 0 ? p_max_records : 1;
+	write_behind_max_buffered = p_max_buffered > write_behind_max_records ? p_max_buffered : write_behind_max_records;
 }
 
-void MySQL::fetch_dictionary(const String &p_query, Object *p_target, const String &p_callback, const Array &p_args) {
-	LOCK();
+void MySQL::write_behind(int p_table, const Array &p_values) {
+	std::lock_guard<std::mutex> lock(write_behind_mutex);
+
+	if (p_table < 0 || p_table >= (int)write_behind_tables.size()) {
+		ERR_PRINT("Write-behind table " + String::num_int64(p_table) + " is not registered.");
+		return;
+	}
 
-	Array user_data;
-	user_data.push_back(p_query);
-	user_data.push_back(p_target);
-	user_data.push_back(p_callback);
-	user_data.push_back(p_args);
+	WriteBehindTable &table = write_behind_tables[p_table];
 
-	QUEUE_TASK(Task::FETCH_DICTIONARY);
+	if (p_values.size() != table.columns) {
+		ERR_PRINT("Write-behind row has " + String::num_int64(p_values.size()) + " values, table expects " + String::num_int64(table.columns) + ".");
+		return;
+	}
 
-    UNLOCK_AND_POST();
+	// Writes are not worth blocking the caller or growing without bound while the database is down.
+	// Oldest rows go first, like when the write-behind worker trims the rows it couldn't write.
+	if ((int)table.rows.size() >= write_behind_max_buffered) {
+		table.rows.pop_front();
+		write_behind_dropped++;
+		write_behind_dropped_unlogged++;
+
+		if (_msec_since(write_behind_drop_logged) >= WRITE_BEHIND_DROP_LOG_MSEC) {
+			ERR_PRINT("MySQL: write-behind buffer is full, " + String::num_int64(write_behind_dropped_unlogged) + " oldest rows dropped.");
+			write_behind_dropped_unlogged = 0;
+			write_behind_drop_logged = std::chrono::steady_clock::now();
+		}
+	}
+
+	table.rows.push_back(p_values);
+
+	if ((int)table.rows.size() >= write_behind_max_records && !write_behind_flush_requested) {
+		write_behind_flush_requested = true;
+		write_behind_condition.notify_one();
+	}
 }
 
-void MySQL::fetch_prepared_dictionary(const String &p_query, const Array &p_params, Object *p_target, const String &p_callback, const Array &p_args) {
+Ref<MySQLRequest> MySQL::connect_to_database() {
+	Ref<MySQLRequest> request;
+	request.instance();
+
+	LOCK();
+
+	bool running = !workers.empty() && !exit;
+
+	if (running && (!connect_reported || connected_workers > 0)) {
+		UNLOCK();
+		WARN_PRINT("Already connected.");
+		request->complete(MySQLRequest::FAILED);
+		return request;
+	}
+
+	bool stale = !workers.empty();
+	UNLOCK();
+
+	// A pool where no worker has a connection is started over, e.g. with new credentials.
+	if (running) {
+		_stop_workers();
+	}
+
+	// Workers of a closed pool have exited or are about to.
+	if (stale) {
+		_join_workers();
+	}
+
 	LOCK();
 
-	Array user_data;
-	user_data.push_back(p_query);
-	user_data.push_back(p_params);
-	user_data.push_back(p_target);
-	user_data.push_back(p_callback);
-	user_data.push_back(p_args);
+	connect_start = std::chrono::steady_clock::now();
+
+	// Driver initializes the client library which must happen before any worker connects.
+	driver = sql::mysql::get_mysql_driver_instance();
+
+	connect_request = request;
+	connect_reported = false;
+	pending_connections = pool_size;
 
-	QUEUE_TASK(Task::FETCH_PREPARED_DICTIONARY);
+	// Every worker opens its own connection, so connections are opened in parallel.
+	// Tasks queued in the meantime wait until a worker is connected.
+	for (int i = 0; i < pool_size; i++) {
+		std::unique_ptr<Worker> worker(new Worker());
+		worker->index = i;
+		worker->write_behind = false;
+		worker->thread.instance();
+		workers.push_back(std::move(worker));
+	}
+
+	for (int i = 0; i < pool_size; i++) {
+		Array data;
+		data.push_back(this);
+		data.push_back(i);
+		workers[i]->thread->start(this, "thread_func", data);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(write_behind_mutex);
+
+		if (!write_behind_tables.empty()) {
+			_start_write_behind();
+		}
+	}
+
+	UNLOCK();
 
-    UNLOCK_AND_POST();
+	return request;
 }
 
-void MySQL::set_schema(const String &p_schema, Object *p_target, const String &p_callback, const Array &p_args) {
-	LOCK();
+Ref<MySQLRequest> MySQL::execute_query(const String &p_query) {
+	return _queue_task(Task::EXECUTE_QUERY, p_query, Array());
+}
 
-	Array user_data;
-	user_data.push_back(p_schema);
-	user_data.push_back(p_target);
-	user_data.push_back(p_callback);
-	user_data.push_back(p_args);
+Ref<MySQLRequest> MySQL::execute_prepared_query(const String &p_query, const Array &p_params) {
+	return _queue_task(Task::EXECUTE_PREPARED_QUERY, p_query, p_params);
+}
 
-	QUEUE_TASK(Task::SET_SCHEMA);
+Ref<MySQLRequest> MySQL::execute_update_query(const String &p_query) {
+	return _queue_task(Task::EXECUTE_UPDATE_QUERY, p_query, Array());
+}
+
+Ref<MySQLRequest> MySQL::execute_prepared_update_query(const String &p_query, const Array &p_params) {
+	return _queue_task(Task::EXECUTE_PREPARED_UPDATE_QUERY, p_query, p_params);
+}
+
+Ref<MySQLRequest> MySQL::execute_select_query(const String &p_query) {
+	return _queue_task(Task::EXECUTE_SELECT_QUERY, p_query, Array());
+}
+
+Ref<MySQLRequest> MySQL::execute_prepared_select_query(const String &p_query, const Array &p_params) {
+	return _queue_task(Task::EXECUTE_PREPARED_SELECT_QUERY, p_query, p_params);
+}
+
+Ref<MySQLRequest> MySQL::fetch_array(const String &p_query) {
+	return _queue_task(Task::FETCH_ARRAY, p_query, Array());
+}
 
-    UNLOCK_AND_POST();
+Ref<MySQLRequest> MySQL::fetch_prepared_array(const String &p_query, const Array &p_params) {
+	return _queue_task(Task::FETCH_PREPARED_ARRAY, p_query, p_params);
 }
 
-void MySQL::close_connection(Object *p_target, const String &p_callback, const Array &p_args) {
+Ref<MySQLRequest> MySQL::fetch_dictionary(const String &p_query) {
+	return _queue_task(Task::FETCH_DICTIONARY, p_query, Array());
+}
+
+Ref<MySQLRequest> MySQL::fetch_prepared_dictionary(const String &p_query, const Array &p_params) {
+	return _queue_task(Task::FETCH_PREPARED_DICTIONARY, p_query, p_params);
+}
+
+Ref<MySQLRequest> MySQL::set_schema(const String &p_schema) {
+	return _queue_task(Task::SET_SCHEMA, p_schema);
+}
+
+Ref<MySQLRequest> MySQL::close_connection() {
 	LOCK();
+	bool unattended = !workers.empty() && !exit && connect_reported && connected_workers == 0;
+	UNLOCK();
 
-	Array user_data;
-	user_data.push_back(p_target);
-	user_data.push_back(p_callback);
-	user_data.push_back(p_args);
+	// No worker takes tasks while none has a connection, so the pool is stopped from here.
+	if (unattended) {
+		_stop_workers();
 
-	QUEUE_TASK(Task::CLOSE_CONNECTION);
+		Ref<MySQLRequest> request;
+		request.instance();
+		request->complete(MySQLRequest::OK);
+		return request;
+	}
 
-	UNLOCK_AND_POST();
+	return _queue_task(Task::CLOSE_CONNECTION);
 }
 
 void MySQL::_register_methods() {
-    register_method("set_credentials", &MySQL::set_credentials);
+	register_method("set_credentials", &MySQL::set_credentials);
+	register_method("set_pool_size", &MySQL::set_pool_size);
+	register_method("set_compression", &MySQL::set_compression);
+	register_method("set_ssl", &MySQL::set_ssl);
+	register_method("set_protocol_buffers", &MySQL::set_protocol_buffers);
+	register_method("register_hot_statement", &MySQL::register_hot_statement);
 
-    register_method("connect_to_database", &MySQL::connect_to_database);
-    register_method("set_schema", &MySQL::set_schema);
+	register_method("set_queue_limit", &MySQL::set_queue_limit);
+	register_method("set_admission_policy", &MySQL::set_admission_policy);
+	register_method("get_queue_stats", &MySQL::get_queue_stats);
 
-    register_method("execute_query", &MySQL::execute_query);
-    register_method("execute_prepared_query", &MySQL::execute_prepared_query);
+	register_method("set_trace_sampling", &MySQL::set_trace_sampling);
+	register_method("set_trace_process_id", &MySQL::set_trace_process_id);
+	register_method("set_trace_id", &MySQL::set_trace_id);
+	register_method("dump_trace", &MySQL::dump_trace);
 
-    register_method("execute_update_query", &MySQL::execute_update_query);
-    register_method("execute_prepared_update_query", &MySQL::execute_prepared_update_query);
+	register_method("connect_to_database", &MySQL::connect_to_database);
+	register_method("set_schema", &MySQL::set_schema);
 
-    register_method("execute_select_query", &MySQL::execute_select_query);
-    register_method("execute_prepared_select_query", &MySQL::execute_prepared_select_query);
+	register_method("execute_query", &MySQL::execute_query);
+	register_method("execute_prepared_query", &MySQL::execute_prepared_query);
 
-    register_method("fetch_array", &MySQL::fetch_array);
-    register_method("fetch_prepared_array", &MySQL::fetch_prepared_array);
+	register_method("execute_update_query", &MySQL::execute_update_query);
+	register_method("execute_prepared_update_query", &MySQL::execute_prepared_update_query);
 
-    register_method("fetch_dictionary", &MySQL::fetch_dictionary);
-    register_method("fetch_prepared_dictionary", &MySQL::fetch_prepared_dictionary);
+	register_method("execute_select_query", &MySQL::execute_select_query);
+	register_method("execute_prepared_select_query", &MySQL::execute_prepared_select_query);
 
-    register_method("close_connection", &MySQL::close_connection);
-    register_method("thread_func", &MySQL::thread_func); //? ???
+	register_method("fetch_array", &MySQL::fetch_array);
+	register_method("fetch_prepared_array", &MySQL::fetch_prepared_array);
+
+	register_method("fetch_dictionary", &MySQL::fetch_dictionary);
+	register_method("fetch_prepared_dictionary", &MySQL::fetch_prepared_dictionary);
+
+	register_method("close_connection", &MySQL::close_connection);
+	register_method("register_write_behind", &MySQL::register_write_behind);
+	register_method("set_write_behind_flush", &MySQL::set_write_behind_flush);
+	register_method("write_behind", &MySQL::write_behind);
+
+	register_method("thread_func", &MySQL::thread_func); //? ???
+	register_method("write_behind_thread_func", &MySQL::write_behind_thread_func);
 }
 
 MySQL::MySQL() {
-    connection_properties["OPT_RECONNECT"] = true;
-
-    driver = nullptr;
-    exit = false;
+	// Workers reconnect themselves (see `_reconnect_worker`), a silent reconnect by the driver would
+	// leave them with prepared statements of the old connection.
+	connection_properties["OPT_RECONNECT"] = false;
+
+	driver = nullptr;
+	exit = false;
+	pool_size = 1;
+	write_behind_compression = false;
+
+	trace_sampling = 0;
+	trace_process_id = 1;
+
+	queue_limit = 0;
+	admission_policy = ADMISSION_REJECT_NEWEST;
+	codel_target_usec = 5000;
+	codel_interval_usec = 100000;
+	codel_above_target_until_usec = 0;
+	codel_shedding = false;
+	rejected_tasks = 0;
+
+	pending_connections = 0;
+	connect_reported = false;
+	connected_workers = 0;
+
+	write_behind_interval_msec = 1000;
+	write_behind_max_records = 100;
+	write_behind_max_buffered = 100000;
+	write_behind_dropped = 0;
+	write_behind_dropped_unlogged = 0;
+	write_behind_flush_requested = false;
+	write_behind_exit = false;
 }
 
 MySQL::~MySQL() {
-    exit = true;
-    semaphore->post();
-    thread->wait_to_finish();
-
-    _close_connection();
+	_stop_workers();
+	_join_workers();
 }
 
 #undef PRINT_SQL_ERROR
 #undef UNLOCK_AND_POST
 #undef UNLOCK
-#undef LOCK
-#undef QUEUE_TASK
\ No newline at end of file
+#undef LOCK
\ No newline at end of file
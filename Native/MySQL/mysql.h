@@ -11,27 +11,75 @@
 
 #include <mysql_driver.h>
 #include <cppconn/resultset.h>
+#include <cppconn/prepared_statement.h>
 #include <boost/smart_ptr.hpp>
 
+#include "mysql_request.h"
+#include "trace_ring.h"
+
 #include <queue>
+#include <deque>
 #include <memory>
+#include <vector>
+#include <unordered_map>
+#include <string>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 
 namespace godot {
 
 class MySQL : public Object {
-    GODOT_CLASS(MySQL, Object);
+	GODOT_CLASS(MySQL, Object);
 
 private:
-    sql::mysql::MySQL_Driver *driver;
-    std::shared_ptr<sql::Connection> connection;
+	sql::mysql::MySQL_Driver *driver;
 	sql::ConnectOptionsMap connection_properties;
 
-    Thread *thread;
-	Mutex *mutex;
-	Semaphore *semaphore;
+	// Every worker owns one connection and the statements prepared on it.
+	struct Worker {
+		int index;
+		bool write_behind;
+		// `connection` is open, `check_connection` makes the next task ping it first (see `_is_connected_to_database`).
+		bool connected;
+		bool check_connection;
+		std::chrono::steady_clock::time_point last_used;
+		Ref<Thread> thread;
+		std::shared_ptr<sql::Connection> connection;
+		std::unordered_map<std::string, std::unique_ptr<sql::PreparedStatement>> prepared_statements;
+		String schema;
+		TraceRing trace;
+	};
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	int pool_size;
+
+	Ref<Mutex> mutex;
+	Ref<Semaphore> semaphore;
+
+	// CLIENT_COMPRESS of the write-behind connection, the pool's is in `connection_properties`.
+	bool write_behind_compression;
+
+	// Queries prepared by every worker right after it connects.
+	std::vector<String> hot_statements;
+	String schema;
 
-    enum Task {
-		CONNECT_TO_DATABSE = 0,
+	// Completed once the first worker is connected (or every worker failed).
+	Ref<MySQLRequest> connect_request;
+	int pending_connections;
+	bool connect_reported;
+	// Workers with an open connection, tasks fail right away while there are none (see `_count_connected_workers`).
+	int connected_workers;
+
+	// Workers that lost their connection retry with an exponential backoff between these.
+	static const int RECONNECT_MIN_MSEC = 100;
+	static const int RECONNECT_MAX_MSEC = 5000;
+	// Connection idle for longer is pinged before it is used.
+	static const int CONNECTION_CHECK_IDLE_MSEC = 10000;
+	std::chrono::steady_clock::time_point connect_start;
+
+	enum Task {
 		SET_SCHEMA = 1,
 		EXECUTE_QUERY = 2,
 		EXECUTE_PREPARED_QUERY = 3,
@@ -46,52 +94,118 @@ private:
 		CLOSE_CONNECTION = 12,
 	};
 
-    struct QueueItem {
+	struct QueueItem {
 		Task task;
-		Array user_data;
+		String query; // Schema for SET_SCHEMA.
+		Array params;
+		Ref<MySQLRequest> request;
+		int64_t trace_id;
 	};
 
-    std::queue<QueueItem> item_queue;
+	// Every `trace_sampling`-th trace id is traced, 0 disables tracing.
+	int trace_sampling;
+	// Process row of the dumped events, shards of a MySQLShards get one each.
+	int trace_process_id;
+
+	int64_t _sample_trace_id(int64_t p_trace_id);
 
-    bool exit;
+	// Trace id of the next task queued by this thread, see `set_trace_id`.
+	static inline thread_local int64_t next_trace_id = -1;
 
-	void _connect_to_database(Object *p_target, const String &p_callback, const Array &p_args);
-	void _set_schema(const String &p_schema, Object *p_target, const String &p_callback, const Array &p_args);
+	std::queue<QueueItem> item_queue;
 
-	void _execute_query(const String &p_query, Object *p_target, const String &p_callback, const Array &p_args);
-	void _execute_prepared_query(const String &p_query, const Array &p_params, Object *p_target, const String &p_callback, const Array &p_args);
+	enum AdmissionPolicy {
+		ADMISSION_REJECT_NEWEST = 0,
+		ADMISSION_CODEL = 1,
+	};
+
+	// Tasks are completed with MySQLRequest::BUSY instead of being queued when the queue holds `queue_limit` tasks
+	// (0 means unbounded) or, with ADMISSION_CODEL, while the queue is standing (see `_update_codel`).
+	int queue_limit;
+	AdmissionPolicy admission_policy;
+	int64_t codel_target_usec;
+	int64_t codel_interval_usec;
+	int64_t codel_above_target_until_usec;
+	bool codel_shedding;
+	int64_t rejected_tasks;
+
+	Ref<MySQLRequest> _queue_task(Task p_task, const String &p_query = String(), const Array &p_params = Array());
+	void _complete_queued_tasks(MySQLRequest::Status p_status);
+	void _count_connected_workers(int p_delta);
+	void _update_codel(int64_t p_sojourn_usec, int64_t p_now_usec);
+
+	// Rows of non-critical writes (audit log, last login) buffered until the write-behind worker
+	// inserts them with one multi-row statement per table, see `_write_behind_thread`.
+	struct WriteBehindTable {
+		String insert;
+		String suffix;
+		int columns;
+		std::deque<Array> rows;
+	};
 
-	void _execute_update_query(const String &p_query, Object *p_target, const String &p_callback, const Array &p_args);
-	void _execute_prepared_update_query(const String &p_query, const Array &p_params, Object *p_target, const String &p_callback, const Array &p_args);
+	std::vector<WriteBehindTable> write_behind_tables;
+	std::unique_ptr<Worker> write_behind_worker;
+	int write_behind_interval_msec;
+	int write_behind_max_records;
+	int write_behind_max_buffered;
+	int64_t write_behind_dropped;
+	// Rows dropped by `write_behind` are logged at most once per interval, with the count since the last log.
+	static const int WRITE_BEHIND_DROP_LOG_MSEC = 1000;
+	int64_t write_behind_dropped_unlogged;
+	std::chrono::steady_clock::time_point write_behind_drop_logged;
+	bool write_behind_flush_requested;
+	bool write_behind_exit;
 
-	void _execute_select_query(const String &p_query, Object *p_target, const String &p_callback, const Array &p_args);
-	void _execute_prepared_select_query(const String &p_query, const Array &p_params, Object *p_target, const String &p_callback, const Array &p_args);
+	// Godot's Semaphore can't wait with a timeout, which the periodic flush needs.
+	std::mutex write_behind_mutex;
+	std::condition_variable write_behind_condition;
 
-	void _fetch_array(const String &p_query, Object *p_target, const String &p_callback, const Array &p_args);
-	void _fetch_prepared_array(const String &p_query, const Array &p_params, Object *p_target, const String &p_callback, const Array &p_args);
+	void _start_write_behind();
+	void _write_behind_thread(Worker *p_worker);
+	size_t _flush_write_behind(Worker *p_worker, const WriteBehindTable &p_batch);
 
-	void _fetch_dictionary(const String &p_query, Object *p_target, const String &p_callback, const Array &p_args);
-	void _fetch_prepared_dictionary(const String &p_query, const Array &p_params, Object *p_target, const String &p_callback, const Array &p_args);
+	// Read by the workers without the mutex.
+	std::atomic<bool> exit;
 
-	void _close_connection(Object *p_target, const String &p_callback, const Array &p_args);
-	void _close_connection();
+	bool _connect_worker(Worker *p_worker);
+	void _prepare_hot_statements(Worker *p_worker, const std::vector<String> &p_statements);
+	bool _reconnect_worker(Worker *p_worker);
+	void _sleep_unless_exit(int64_t p_msec);
+	void _stop_workers();
+	void _join_workers();
+	void _report_connection(bool p_success);
+	void _set_schema(Worker *p_worker, const String &p_schema, const Ref<MySQLRequest> &p_request);
 
-	bool _is_connected_to_database() const;
+	void _execute_query(Worker *p_worker, const String &p_query, const Ref<MySQLRequest> &p_request);
+	void _execute_prepared_query(Worker *p_worker, const String &p_query, const Array &p_params, const Ref<MySQLRequest> &p_request);
+
+	void _execute_update_query(Worker *p_worker, const String &p_query, const Ref<MySQLRequest> &p_request);
+	void _execute_prepared_update_query(Worker *p_worker, const String &p_query, const Array &p_params, const Ref<MySQLRequest> &p_request);
+
+	void _execute_select_query(Worker *p_worker, const String &p_query, const Ref<MySQLRequest> &p_request);
+	void _execute_prepared_select_query(Worker *p_worker, const String &p_query, const Array &p_params, const Ref<MySQLRequest> &p_request);
+
+	void _fetch_array(Worker *p_worker, const String &p_query, const Ref<MySQLRequest> &p_request);
+	void _fetch_prepared_array(Worker *p_worker, const String &p_query, const Array &p_params, const Ref<MySQLRequest> &p_request);
+
+	void _fetch_dictionary(Worker *p_worker, const String &p_query, const Ref<MySQLRequest> &p_request);
+	void _fetch_prepared_dictionary(Worker *p_worker, const String &p_query, const Array &p_params, const Ref<MySQLRequest> &p_request);
+
+	void _close_connection(Worker *p_worker, const Ref<MySQLRequest> &p_request);
+	static void _close_connection(Worker *p_worker);
+
+	bool _is_connected_to_database(Worker *p_worker);
+	void _sync_schema(Worker *p_worker);
+
+	static sql::PreparedStatement *_get_prepared_statement(Worker *p_worker, const String &p_query, std::unique_ptr<sql::PreparedStatement> *p_owned);
 
 	static bool _is_sql_datetime(const String &p_datetime);
 
-	static void _prepare_statement(const std::unique_ptr<sql::PreparedStatement> &p_prepared_statement, const Array &p_params);
+	static void _prepare_statement(sql::PreparedStatement *p_prepared_statement, const Array &p_params);
 
 	static void _process_result_set_as_dictionary(const std::unique_ptr<sql::ResultSet> &p_result_set, Array *p_result_array);
 	static void _process_result_set_as_array(const std::unique_ptr<sql::ResultSet> &p_result_set, Array *p_result_array);
 
-	template<class... Args>
-	inline static void _call_function(Object *p_target, const String &p_callback, Args ...p_args) {
-		if (p_target) {
-			p_target->call(p_callback, p_args...);
-		}
-	}
-
 	inline static sql::SQLString godot_string_to_sql(const String &p_string) {
 		sql::SQLString sql_string(p_string.utf8().get_data());
 		return sql_string;
@@ -102,39 +216,62 @@ private:
 		return string;
 	}
 	
-	void _thread();
+	void _thread(Worker *p_worker);
+
+	static int64_t _msec_since(const std::chrono::steady_clock::time_point &p_start);
 
 public:
-    static void _register_methods();
+	static void _register_methods();
 
-    void _init();
+	void _init();
 
 	void thread_func(const Array &p_data);
-
-    void connect_to_database(Object *p_target, const String &p_callback, const Array &p_args);
-    void set_credentials(const String &p_host, const String &p_username, const String &p_password, int p_port);
+	void write_behind_thread_func(const Array &p_data);
+
+	Ref<MySQLRequest> connect_to_database();
+	void set_credentials(const String &p_host, const String &p_username, const String &p_password, int p_port);
+	void set_pool_size(int p_size);
+	void set_compression(bool p_workers, bool p_write_behind);
+	void set_ssl(int p_mode, const String &p_ca, const String &p_cert, const String &p_key);
+	void set_protocol_buffers(int p_net_buffer_length, int p_max_allowed_packet);
+	void register_hot_statement(const String &p_query);
+
+	void set_queue_limit(int p_limit);
+	void set_admission_policy(int p_policy, int p_target_msec, int p_interval_msec);
+	Dictionary get_queue_stats();
+
+	int register_write_behind(const String &p_insert, int p_columns, const String &p_suffix);
+	void set_write_behind_flush(int p_interval_msec, int p_max_records, int p_max_buffered);
+	void write_behind(int p_table, const Array &p_values);
+
+	void set_trace_sampling(int p_one_in);
+	void set_trace_process_id(int p_process_id);
+	// Identifies the next task queued by the calling thread in the dumped trace (e.g. by the login id).
+	// The id is kept per thread, so tasks queued by other threads in the meantime don't take it.
+	void set_trace_id(int p_trace_id);
+	String dump_trace();
 	
-	void set_schema(const String &p_schema, Object *p_target, const String &p_callback, const Array &p_args);
+	Ref<MySQLRequest> set_schema(const String &p_schema);
 
-	void execute_query(const String &p_query, Object *p_target, const String &p_callback, const Array &p_args);
-	void execute_prepared_query(const String &p_query, const Array &p_params, Object *p_target, const String &p_callback, const Array &p_args);
+	Ref<MySQLRequest> execute_query(const String &p_query);
+	Ref<MySQLRequest> execute_prepared_query(const String &p_query, const Array &p_params);
 
-	void execute_update_query(const String &p_query, Object *p_target, const String &p_callback, const Array &p_args);
-	void execute_prepared_update_query(const String &p_query, const Array &p_params, Object *p_target, const String &p_callback, const Array &p_args);
+	Ref<MySQLRequest> execute_update_query(const String &p_query);
+	Ref<MySQLRequest> execute_prepared_update_query(const String &p_query, const Array &p_params);
 
-	void execute_select_query(const String &p_query, Object *p_target, const String &p_callback, const Array &p_args);
-	void execute_prepared_select_query(const String &p_query, const Array &p_params, Object *p_target, const String &p_callback, const Array &p_args);
+	Ref<MySQLRequest> execute_select_query(const String &p_query);
+	Ref<MySQLRequest> execute_prepared_select_query(const String &p_query, const Array &p_params);
 
-	void fetch_array(const String &p_query, Object *p_target, const String &p_callback, const Array &p_args);
-	void fetch_prepared_array(const String &p_query, const Array &p_params, Object *p_target, const String &p_callback, const Array &p_args);
+	Ref<MySQLRequest> fetch_array(const String &p_query);
+	Ref<MySQLRequest> fetch_prepared_array(const String &p_query, const Array &p_params);
 
-	void fetch_dictionary(const String &p_query, Object *p_target, const String &p_callback, const Array &p_args);
-	void fetch_prepared_dictionary(const String &p_query, const Array &p_params, Object *p_target, const String &p_callback, const Array &p_args);
+	Ref<MySQLRequest> fetch_dictionary(const String &p_query);
+	Ref<MySQLRequest> fetch_prepared_dictionary(const String &p_query, const Array &p_params);
 
-	void close_connection(Object *p_target, const String &p_callback, const Array &p_args);
+	Ref<MySQLRequest> close_connection();
 
-    MySQL();
-    ~MySQL();
+	MySQL();
+	~MySQL();
 };
 
 }
@@ -0,0 +1,193 @@
+#include "mysql_request.h"
+
+#include "trace_ring.h"
+
+using namespace godot;
+
+
+void MySQLRequest::_init() {
+	queued_usec = TraceRing::now_usec();
+}
+
+bool MySQLRequest::start() {
+	int expected = PENDING;
+	if (!status.compare_exchange_strong(expected, RUNNING)) {
+		return false;
+	}
+
+	started_usec = TraceRing::now_usec();
+	return true;
+}
+
+void MySQLRequest::complete(Status p_status, int64_t p_row_count, const Array &p_rows) {
+	rows = p_rows;
+	row_count = p_row_count;
+	completed_usec = TraceRing::now_usec();
+
+	if (started_usec == 0) {
+		started_usec = completed_usec;
+	}
+
+	status.store(p_status, std::memory_order_release);
+
+	_finish();
+}
+
+void MySQLRequest::_finish() {
+	// Deferred calls run on the main thread, the caller never sees the signal from a worker thread.
+	// Time spent in the handlers is up to the caller to trace, the worker is long gone by then.
+	call_deferred("emit_signal", "completed", get_status(), row_count);
+
+	Ref<MySQLRequest> whole;
+	{
+		std::lock_guard<std::mutex> lock(gather_mutex);
+		whole = gather;
+		gather.unref();
+	}
+
+	if (whole.is_valid()) {
+		whole->_complete_part((Status)get_status(), row_count, rows);
+	}
+}
+
+void MySQLRequest::gather_parts(const std::vector<Ref<MySQLRequest>> &p_parts) {
+	start();
+
+	{
+		std::lock_guard<std::mutex> lock(gather_mutex);
+
+		// One extra pending part, so the gather can't complete before every part is attached.
+		parts = p_parts;
+		pending_parts = parts.size() + 1;
+		gather_status = OK;
+		gather_row_count = 0;
+	}
+
+	for (const Ref<MySQLRequest> &part : p_parts) {
+		bool attached;
+		{
+			// A part completes after it stored its status, so it either sees the gather or was already counted here.
+			std::lock_guard<std::mutex> lock(part->gather_mutex);
+			attached = !part->is_completed();
+			if (attached) {
+				part->gather = Ref<MySQLRequest>(this);
+			}
+		}
+
+		if (!attached) {
+			_complete_part((Status)part->get_status(), part->row_count, part->rows);
+		}
+	}
+
+	_complete_part(OK, 0, Array());
+}
+
+void MySQLRequest::_complete_part(Status p_status, int64_t p_row_count, const Array &p_rows) {
+	std::unique_lock<std::mutex> lock(gather_mutex);
+
+	// Affected rows of updates, fetched rows of fetches.
+	gather_row_count += p_row_count;
+
+	for (int i = 0; i < p_rows.size(); i++) {
+		rows.push_back(p_rows[i]);
+	}
+
+	// Any part that didn't succeed decides the status, rows of the others are kept.
+	if (p_status != OK && (gather_status == OK || p_status == FAILED)) {
+		gather_status = p_status;
+	}
+
+	if (--pending_parts > 0) {
+		return;
+	}
+
+	std::vector<Ref<MySQLRequest>> finished_parts;
+	finished_parts.swap(parts);
+	Array merged_rows = rows;
+	int64_t merged_row_count = gather_row_count;
+	lock.unlock();
+
+	complete(gather_status, merged_row_count, merged_rows);
+}
+
+bool MySQLRequest::cancel() {
+	if (get_status() == RUNNING) {
+		std::vector<Ref<MySQLRequest>> gathered;
+		{
+			std::lock_guard<std::mutex> lock(gather_mutex);
+			gathered = parts;
+		}
+
+		// Gather completes as soon as its last part does.
+		bool cancelled = false;
+		for (const Ref<MySQLRequest> &part : gathered) {
+			cancelled = part->cancel() || cancelled;
+		}
+		return cancelled;
+	}
+
+	int expected = PENDING;
+	if (!status.compare_exchange_strong(expected, CANCELLED)) {
+		return false;
+	}
+
+	// Worker drops the request once it gets to it.
+	completed_usec = TraceRing::now_usec();
+	started_usec = completed_usec;
+	_finish();
+
+	return true;
+}
+
+int MySQLRequest::get_status() const {
+	return status.load(std::memory_order_acquire);
+}
+
+bool MySQLRequest::is_completed() const {
+	return get_status() > RUNNING;
+}
+
+Array MySQLRequest::get_rows() const {
+	return rows;
+}
+
+int64_t MySQLRequest::get_row_count() const {
+	return row_count;
+}
+
+int64_t MySQLRequest::get_wait_usec() const {
+	return is_completed() ? started_usec - queued_usec : 0;
+}
+
+int64_t MySQLRequest::get_execution_usec() const {
+	return is_completed() ? completed_usec - started_usec : 0;
+}
+
+void MySQLRequest::_register_methods() {
+	register_method("cancel", &MySQLRequest::cancel);
+
+	register_method("get_status", &MySQLRequest::get_status);
+	register_method("is_completed", &MySQLRequest::is_completed);
+
+	register_method("get_rows", &MySQLRequest::get_rows);
+	register_method("get_row_count", &MySQLRequest::get_row_count);
+
+	register_method("get_wait_usec", &MySQLRequest::get_wait_usec);
+	register_method("get_execution_usec", &MySQLRequest::get_execution_usec);
+
+	register_signal<MySQLRequest>("completed", "status", GODOT_VARIANT_TYPE_INT, "row_count", GODOT_VARIANT_TYPE_INT);
+}
+
+MySQLRequest::MySQLRequest() {
+	status = PENDING;
+	row_count = 0;
+	queued_usec = 0;
+	started_usec = 0;
+	completed_usec = 0;
+	pending_parts = 0;
+	gather_status = OK;
+	gather_row_count = 0;
+}
+
+MySQLRequest::~MySQLRequest() {
+}
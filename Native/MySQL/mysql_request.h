@@ -0,0 +1,84 @@
+#ifndef MYSQL_REQUEST_H
+#define MYSQL_REQUEST_H
+
+#include <Godot.hpp>
+#include <Reference.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace godot {
+
+// Handle of a single MySQL call. `completed(status, row_count)` is emitted on the main thread once the call
+// finished, failed, was cancelled or refused, so it can be awaited from C# with `ToSignal(request, "completed")`.
+class MySQLRequest : public Reference {
+	GODOT_CLASS(MySQLRequest, Reference);
+
+public:
+	enum Status {
+		PENDING = 0,
+		RUNNING = 1,
+		OK = 2,
+		FAILED = 3,
+		BUSY = 4,
+		CANCELLED = 5,
+	};
+
+private:
+	std::atomic<int> status;
+
+	// Written by the worker before `completed` is emitted, read after it.
+	Array rows;
+	int64_t row_count;
+
+	int64_t queued_usec;
+	int64_t started_usec;
+	int64_t completed_usec;
+
+	// Scatter-gather: a gather request completes once all of its parts did, with their rows merged and row counts summed.
+	// Parts keep the gather alive until they complete, the gather drops its parts then.
+	Ref<MySQLRequest> gather;
+	std::vector<Ref<MySQLRequest>> parts;
+	int pending_parts;
+	Status gather_status;
+	int64_t gather_row_count;
+	std::mutex gather_mutex;
+
+	void _finish();
+	void _complete_part(Status p_status, int64_t p_row_count, const Array &p_rows);
+
+public:
+	static void _register_methods();
+
+	void _init();
+
+	// Called by the worker that takes the request from the queue.
+	// Returns false if the request was cancelled in the meantime and must not run.
+	bool start();
+	void complete(Status p_status, int64_t p_row_count = 0, const Array &p_rows = Array());
+
+	int64_t get_queued_usec() const { return queued_usec; }
+
+	// Makes this request a gather of `p_parts`, which may have completed already.
+	void gather_parts(const std::vector<Ref<MySQLRequest>> &p_parts);
+
+	bool cancel();
+
+	int get_status() const;
+	bool is_completed() const;
+
+	Array get_rows() const;
+	int64_t get_row_count() const;
+
+	int64_t get_wait_usec() const;
+	int64_t get_execution_usec() const;
+
+	MySQLRequest();
+	~MySQLRequest();
+};
+
+}
+
+#endif // MYSQL_REQUEST_H
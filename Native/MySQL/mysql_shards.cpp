@@ -0,0 +1,331 @@
+#include "mysql_shards.h"
+
+#include <algorithm>
+
+using namespace godot;
+
+
+uint64_t MySQLShards::_hash(const CharString &p_key) {
+	// FNV-1a, finished with the MurmurHash3 mix so similar logins spread over the whole ring.
+	uint64_t hash = 14695981039346656037ULL;
+	const char *data = p_key.get_data();
+
+	for (int i = 0; i < p_key.length(); i++) {
+		hash ^= (uint8_t)data[i];
+		hash *= 1099511628211ULL;
+	}
+
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= hash >> 33;
+
+	return hash;
+}
+
+int MySQLShards::_route(const String &p_key) const {
+	if (ring.empty()) {
+		return -1;
+	}
+
+	RingPoint point;
+	point.hash = _hash(p_key.utf8());
+	point.shard = -1;
+
+	// First point clockwise from the key, wrapping around.
+	std::vector<RingPoint>::const_iterator it = std::lower_bound(ring.begin(), ring.end(), point);
+	if (it == ring.end()) {
+		it = ring.begin();
+	}
+
+	return it->shard;
+}
+
+template<class F>
+Ref<MySQLRequest> MySQLShards::_scatter(F p_call) {
+	std::vector<Ref<MySQLRequest>> parts;
+	for (const Shard &shard : shards) {
+		parts.push_back(p_call(shard.mysql));
+	}
+
+	Ref<MySQLRequest> request;
+	request.instance();
+	request->gather_parts(parts);
+
+	return request;
+}
+
+MySQL *MySQLShards::_get_shard(const String &p_key) {
+	int index = _route(p_key);
+	if (index < 0) {
+		ERR_PRINT("No shard was added.");
+		return nullptr;
+	}
+
+	return shards[index].mysql;
+}
+
+// Hands the trace id over to the shard, which gives it to the task it queues next.
+MySQL *MySQLShards::_get_traced_shard(const String &p_key) {
+	int trace_id = next_trace_id;
+	next_trace_id = -1;
+
+	MySQL *mysql = _get_shard(p_key);
+	if (mysql) {
+		mysql->set_trace_id(trace_id);
+	}
+
+	return mysql;
+}
+
+Ref<MySQLRequest> MySQLShards::_failed_request() {
+	Ref<MySQLRequest> request;
+	request.instance();
+	request->complete(MySQLRequest::FAILED);
+
+	return request;
+}
+
+void MySQLShards::_init() {
+}
+
+void MySQLShards::set_virtual_nodes(int p_virtual_nodes) {
+	if (!shards.empty()) {
+		WARN_PRINT("Virtual nodes can't be changed after a shard was added.");
+		return;
+	}
+
+	virtual_nodes = p_virtual_nodes > 0 ? p_virtual_nodes : 1;
+}
+
+void MySQLShards::add_shard(const String &p_name, const String &p_host, int p_port) {
+	for (const Shard &shard : shards) {
+		if (shard.name == p_name) {
+			ERR_PRINT("Shard " + p_name + " was already added.");
+			return;
+		}
+	}
+
+	// Script never sees the instance, so it is freed only by the destructor.
+	Shard shard;
+	shard.name = p_name;
+	shard.host = p_host;
+	shard.port = p_port;
+	shard.mysql = MySQL::_new();
+	shards.push_back(shard);
+
+	// Points depend on the name only, so the points of the other shards stay where they were.
+	int index = shards.size() - 1;
+	for (int i = 0; i < virtual_nodes; i++) {
+		RingPoint point;
+		point.hash = _hash((p_name + "#" + String::num_int64(i)).utf8());
+		point.shard = index;
+		ring.push_back(point);
+	}
+
+	std::sort(ring.begin(), ring.end());
+
+	// Trace events of every shard get their own process row.
+	shard.mysql->set_trace_process_id(index + 2);
+}
+
+int MySQLShards::get_shard_count() const {
+	return shards.size();
+}
+
+String MySQLShards::get_shard_name(const String &p_key) {
+	int index = _route(p_key);
+	return index >= 0 ? shards[index].name : String();
+}
+
+void MySQLShards::set_credentials(const String &p_username, const String &p_password) {
+	for (const Shard &shard : shards) {
+		shard.mysql->set_credentials(shard.host, p_username, p_password, shard.port);
+	}
+}
+
+void MySQLShards::set_pool_size(int p_size) {
+	for (const Shard &shard : shards) {
+		shard.mysql->set_pool_size(p_size);
+	}
+}
+
+void MySQLShards::set_compression(bool p_workers, bool p_write_behind) {
+	for (const Shard &shard : shards) {
+		shard.mysql->set_compression(p_workers, p_write_behind);
+	}
+}
+
+void MySQLShards::set_ssl(int p_mode, const String &p_ca, const String &p_cert, const String &p_key) {
+	for (const Shard &shard : shards) {
+		shard.mysql->set_ssl(p_mode, p_ca, p_cert, p_key);
+	}
+}
+
+void MySQLShards::set_protocol_buffers(int p_net_buffer_length, int p_max_allowed_packet) {
+	for (const Shard &shard : shards) {
+		shard.mysql->set_protocol_buffers(p_net_buffer_length, p_max_allowed_packet);
+	}
+}
+
+void MySQLShards::register_hot_statement(const String &p_query) {
+	for (const Shard &shard : shards) {
+		shard.mysql->register_hot_statement(p_query);
+	}
+}
+
+void MySQLShards::set_queue_limit(int p_limit) {
+	for (const Shard &shard : shards) {
+		shard.mysql->set_queue_limit(p_limit);
+	}
+}
+
+void MySQLShards::set_admission_policy(int p_policy, int p_target_msec, int p_interval_msec) {
+	for (const Shard &shard : shards) {
+		shard.mysql->set_admission_policy(p_policy, p_target_msec, p_interval_msec);
+	}
+}
+
+void MySQLShards::set_trace_sampling(int p_one_in) {
+	for (const Shard &shard : shards) {
+		shard.mysql->set_trace_sampling(p_one_in);
+	}
+}
+
+int MySQLShards::register_write_behind(const String &p_insert, int p_columns, const String &p_suffix) {
+	int table = -1;
+	for (const Shard &shard : shards) {
+		table = shard.mysql->register_write_behind(p_insert, p_columns, p_suffix);
+	}
+
+	return table;
+}
+
+void MySQLShards::set_write_behind_flush(int p_interval_msec, int p_max_records, int p_max_buffered) {
+	for (const Shard &shard : shards) {
+		shard.mysql->set_write_behind_flush(p_interval_msec, p_max_records, p_max_buffered);
+	}
+}
+
+Ref<MySQLRequest> MySQLShards::connect_to_database() {
+	return _scatter([&](MySQL *p_mysql) { return p_mysql->connect_to_database(); });
+}
+
+Ref<MySQLRequest> MySQLShards::set_schema(const String &p_schema) {
+	return _scatter([&](MySQL *p_mysql) { return p_mysql->set_schema(p_schema); });
+}
+
+Ref<MySQLRequest> MySQLShards::close_connection() {
+	return _scatter([&](MySQL *p_mysql) { return p_mysql->close_connection(); });
+}
+
+void MySQLShards::set_trace_id(int p_trace_id) {
+	next_trace_id = p_trace_id;
+}
+
+Ref<MySQLRequest> MySQLShards::execute_prepared_select_query(const String &p_key, const String &p_query, const Array &p_params) {
+	MySQL *mysql = _get_traced_shard(p_key);
+	return mysql ? mysql->execute_prepared_select_query(p_query, p_params) : _failed_request();
+}
+
+Ref<MySQLRequest> MySQLShards::execute_prepared_update_query(const String &p_key, const String &p_query, const Array &p_params) {
+	MySQL *mysql = _get_traced_shard(p_key);
+	return mysql ? mysql->execute_prepared_update_query(p_query, p_params) : _failed_request();
+}
+
+Ref<MySQLRequest> MySQLShards::fetch_prepared_array(const String &p_key, const String &p_query, const Array &p_params) {
+	MySQL *mysql = _get_traced_shard(p_key);
+	return mysql ? mysql->fetch_prepared_array(p_query, p_params) : _failed_request();
+}
+
+Ref<MySQLRequest> MySQLShards::fetch_prepared_dictionary(const String &p_key, const String &p_query, const Array &p_params) {
+	MySQL *mysql = _get_traced_shard(p_key);
+	return mysql ? mysql->fetch_prepared_dictionary(p_query, p_params) : _failed_request();
+}
+
+void MySQLShards::write_behind(const String &p_key, int p_table, const Array &p_values) {
+	MySQL *mysql = _get_shard(p_key);
+	if (mysql) {
+		mysql->write_behind(p_table, p_values);
+	}
+}
+
+Ref<MySQLRequest> MySQLShards::fetch_prepared_array_all(const String &p_query, const Array &p_params) {
+	return _scatter([&](MySQL *p_mysql) { return p_mysql->fetch_prepared_array(p_query, p_params); });
+}
+
+Ref<MySQLRequest> MySQLShards::fetch_prepared_dictionary_all(const String &p_query, const Array &p_params) {
+	return _scatter([&](MySQL *p_mysql) { return p_mysql->fetch_prepared_dictionary(p_query, p_params); });
+}
+
+Ref<MySQLRequest> MySQLShards::execute_prepared_update_query_all(const String &p_query, const Array &p_params) {
+	return _scatter([&](MySQL *p_mysql) { return p_mysql->execute_prepared_update_query(p_query, p_params); });
+}
+
+String MySQLShards::dump_trace() {
+	String json = "[";
+
+	for (const Shard &shard : shards) {
+		String events = shard.mysql->dump_trace();
+		if (events.length() <= 2) {
+			continue;
+		}
+
+		if (json.length() > 1) {
+			json += ",";
+		}
+		json += events.substr(1, events.length() - 2);
+	}
+
+	return json + "]";
+}
+
+void MySQLShards::_register_methods() {
+	register_method("set_virtual_nodes", &MySQLShards::set_virtual_nodes);
+	register_method("add_shard", &MySQLShards::add_shard);
+	register_method("get_shard_count", &MySQLShards::get_shard_count);
+	register_method("get_shard_name", &MySQLShards::get_shard_name);
+
+	register_method("set_credentials", &MySQLShards::set_credentials);
+	register_method("set_pool_size", &MySQLShards::set_pool_size);
+	register_method("set_compression", &MySQLShards::set_compression);
+	register_method("set_ssl", &MySQLShards::set_ssl);
+	register_method("set_protocol_buffers", &MySQLShards::set_protocol_buffers);
+	register_method("register_hot_statement", &MySQLShards::register_hot_statement);
+	register_method("set_queue_limit", &MySQLShards::set_queue_limit);
+	register_method("set_admission_policy", &MySQLShards::set_admission_policy);
+	register_method("set_trace_sampling", &MySQLShards::set_trace_sampling);
+	register_method("register_write_behind", &MySQLShards::register_write_behind);
+	register_method("set_write_behind_flush", &MySQLShards::set_write_behind_flush);
+
+	register_method("connect_to_database", &MySQLShards::connect_to_database);
+	register_method("set_schema", &MySQLShards::set_schema);
+	register_method("close_connection", &MySQLShards::close_connection);
+
+	register_method("set_trace_id", &MySQLShards::set_trace_id);
+	register_method("execute_prepared_select_query", &MySQLShards::execute_prepared_select_query);
+	register_method("execute_prepared_update_query", &MySQLShards::execute_prepared_update_query);
+	register_method("fetch_prepared_array", &MySQLShards::fetch_prepared_array);
+	register_method("fetch_prepared_dictionary", &MySQLShards::fetch_prepared_dictionary);
+	register_method("write_behind", &MySQLShards::write_behind);
+
+	register_method("fetch_prepared_array_all", &MySQLShards::fetch_prepared_array_all);
+	register_method("fetch_prepared_dictionary_all", &MySQLShards::fetch_prepared_dictionary_all);
+	register_method("execute_prepared_update_query_all", &MySQLShards::execute_prepared_update_query_all);
+
+	register_method("dump_trace", &MySQLShards::dump_trace);
+}
+
+MySQLShards::MySQLShards() {
+	virtual_nodes = 128;
+	next_trace_id = -1;
+}
+
+MySQLShards::~MySQLShards() {
+	// Instances were created by `add_shard` and are referenced nowhere else.
+	// Each shard joins its workers in its destructor.
+	for (const Shard &shard : shards) {
+		godot::api->godot_object_destroy(shard.mysql->_owner);
+	}
+}
@@ -0,0 +1,106 @@
+#ifndef MYSQL_SHARDS_H
+#define MYSQL_SHARDS_H
+
+#include <Godot.hpp>
+#include <Object.hpp>
+
+#include "mysql.h"
+
+#include <vector>
+#include <cstdint>
+
+namespace godot {
+
+// Routes queries to one of several MySQL instances (shards, each with its own workers and connections)
+// by a shard key such as the login. Keys are placed on a consistent hash ring where every shard owns
+// `virtual_nodes` points, so adding a shard moves only the keys that now belong to it (about 1/N of them).
+// Shards are created and owned by MySQLShards and never handed out, scripts configure and query them
+// through the methods below. Shards are added, configured and queried from the main thread.
+class MySQLShards : public Object {
+	GODOT_CLASS(MySQLShards, Object);
+
+private:
+	struct Shard {
+		String name;
+		String host;
+		int port;
+		MySQL *mysql;
+	};
+
+	struct RingPoint {
+		uint64_t hash;
+		int shard;
+
+		bool operator<(const RingPoint &p_other) const {
+			return hash < p_other.hash || (hash == p_other.hash && shard < p_other.shard);
+		}
+	};
+
+	std::vector<Shard> shards;
+	std::vector<RingPoint> ring;
+	int virtual_nodes;
+	// Trace id of the next routed query, see `set_trace_id`.
+	int next_trace_id;
+
+	static uint64_t _hash(const CharString &p_key);
+	int _route(const String &p_key) const;
+
+	template<class F>
+	Ref<MySQLRequest> _scatter(F p_call);
+	MySQL *_get_shard(const String &p_key);
+	MySQL *_get_traced_shard(const String &p_key);
+	static Ref<MySQLRequest> _failed_request();
+
+public:
+	static void _register_methods();
+
+	void _init();
+
+	void set_virtual_nodes(int p_virtual_nodes);
+	void add_shard(const String &p_name, const String &p_host, int p_port);
+	int get_shard_count() const;
+	String get_shard_name(const String &p_key);
+
+	// Applied to every shard added so far.
+	void set_credentials(const String &p_username, const String &p_password);
+	void set_pool_size(int p_size);
+	void set_compression(bool p_workers, bool p_write_behind);
+	void set_ssl(int p_mode, const String &p_ca, const String &p_cert, const String &p_key);
+	void set_protocol_buffers(int p_net_buffer_length, int p_max_allowed_packet);
+	void register_hot_statement(const String &p_query);
+	void set_queue_limit(int p_limit);
+	void set_admission_policy(int p_policy, int p_target_msec, int p_interval_msec);
+	void set_trace_sampling(int p_one_in);
+	// Every shard registers the tables in the same order, so the returned index is the same on all of them.
+	int register_write_behind(const String &p_insert, int p_columns, const String &p_suffix);
+	void set_write_behind_flush(int p_interval_msec, int p_max_records, int p_max_buffered);
+
+	// Completed once every shard completed.
+	Ref<MySQLRequest> connect_to_database();
+	Ref<MySQLRequest> set_schema(const String &p_schema);
+	Ref<MySQLRequest> close_connection();
+
+	// Identifies the next routed query in the dumped trace, on whichever shard it runs.
+	void set_trace_id(int p_trace_id);
+
+	// Run on the shard that owns `p_key`.
+	Ref<MySQLRequest> execute_prepared_select_query(const String &p_key, const String &p_query, const Array &p_params);
+	Ref<MySQLRequest> execute_prepared_update_query(const String &p_key, const String &p_query, const Array &p_params);
+	Ref<MySQLRequest> fetch_prepared_array(const String &p_key, const String &p_query, const Array &p_params);
+	Ref<MySQLRequest> fetch_prepared_dictionary(const String &p_key, const String &p_query, const Array &p_params);
+	void write_behind(const String &p_key, int p_table, const Array &p_values);
+
+	// Run on every shard, rows of all shards are merged into one request.
+	Ref<MySQLRequest> fetch_prepared_array_all(const String &p_query, const Array &p_params);
+	Ref<MySQLRequest> fetch_prepared_dictionary_all(const String &p_query, const Array &p_params);
+	Ref<MySQLRequest> execute_prepared_update_query_all(const String &p_query, const Array &p_params);
+
+	String dump_trace();
+
+	MySQLShards();
+	~MySQLShards();
+};
+
+}
+
+#endif // MYSQL_SHARDS_H
@@ -0,0 +1,102 @@
+#ifndef TRACE_RING_H
+#define TRACE_RING_H
+
+#include <Godot.hpp>
+#include <OS.hpp>
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+
+namespace godot {
+
+struct TraceEvent {
+	const char *name;
+	int64_t trace_id;
+	int64_t start_usec;
+	int64_t duration_usec;
+};
+
+// Fixed size ring of trace events with a single writer (the thread that owns it).
+// Writing never blocks or allocates, the oldest events are overwritten.
+class TraceRing {
+	std::vector<TraceEvent> events;
+	uint64_t mask;
+	std::atomic<uint64_t> head;
+
+public:
+	explicit TraceRing(uint64_t p_capacity_pow2 = 4096) :
+			events(p_capacity_pow2), mask(p_capacity_pow2 - 1), head(0) {}
+
+	void push(const char *p_name, int64_t p_trace_id, int64_t p_start_usec, int64_t p_duration_usec) {
+		uint64_t index = head.load(std::memory_order_relaxed);
+
+		TraceEvent &event = events[index & mask];
+		event.name = p_name;
+		event.trace_id = p_trace_id;
+		event.start_usec = p_start_usec;
+		event.duration_usec = p_duration_usec;
+
+		head.store(index + 1, std::memory_order_release);
+	}
+
+	// Copies events that were not overwritten while copying. Safe to call from any thread.
+	void snapshot(std::vector<TraceEvent> *r_events) const {
+		uint64_t end = head.load(std::memory_order_acquire);
+		uint64_t begin = end > events.size() ? end - events.size() : 0;
+
+		size_t first = r_events->size();
+		for (uint64_t i = begin; i < end; i++) {
+			r_events->push_back(events[i & mask]);
+		}
+
+		// Drop the events the writer may have overwritten in the meantime, including the slot of event `after`
+		// which it may be writing right now.
+		uint64_t after = head.load(std::memory_order_acquire) + 1;
+		uint64_t valid_begin = after > events.size() ? after - events.size() : 0;
+		if (valid_begin > begin) {
+			uint64_t torn = valid_begin - begin < end - begin ? valid_begin - begin : end - begin;
+			r_events->erase(r_events->begin() + first, r_events->begin() + first + torn);
+		}
+	}
+
+	static int64_t now_usec() {
+		return OS::get_singleton()->get_ticks_usec();
+	}
+};
+
+// Trace state of the current worker thread. Spans are recorded only while `trace_id` is not negative.
+struct TraceContext {
+	static inline thread_local TraceRing *ring = nullptr;
+	static inline thread_local int64_t trace_id = -1;
+};
+
+// Records a span from construction until `end()` or destruction.
+class TraceScope {
+	const char *name;
+	int64_t start_usec;
+	bool active;
+
+public:
+	explicit TraceScope(const char *p_name) :
+			name(p_name), start_usec(0), active(TraceContext::ring != nullptr && TraceContext::trace_id >= 0) {
+		if (active) {
+			start_usec = TraceRing::now_usec();
+		}
+	}
+
+	void end() {
+		if (active) {
+			TraceContext::ring->push(name, TraceContext::trace_id, start_usec, TraceRing::now_usec() - start_usec);
+			active = false;
+		}
+	}
+
+	~TraceScope() {
+		end();
+	}
+};
+
+}
+
+#endif // TRACE_RING_H
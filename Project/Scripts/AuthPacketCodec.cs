@@ -0,0 +1,258 @@
+using System.Text;
+
+namespace AuthenticationServer
+{
+    /// <summary>
+    ///     Fixed layout binary encoding of packets exchanged with Gateway and Game World Servers during authentication.
+    ///     Every packet is a frame:
+    ///     <code>
+    ///         u16 body length (little endian) | u8 frame kind | body
+    ///     </code>
+    ///     Frames are self delimiting, so several of them can be sent back to back in a single byte array.
+    ///     Bodies:
+    ///     <code>
+    ///         AuthForward:  i32 client id | u8 login length | login (UTF-8) | u8 password length | password (UTF-8) | u8 ip length | client ip (ASCII)
+    ///         AuthResponse: i32 client id | u8 status | u8 ip length | ip (ASCII) | u8 token length (0 or 64) | token
+    ///         SendToken:    token (64 bytes)
+    ///     </code>
+    /// </summary>
+    public static class AuthPacketCodec
+    {
+        public enum FrameKind : byte
+        {
+            AuthForward = 1,
+            AuthResponse = 2,
+            SendToken = 3,
+        }
+
+        /// <summary>
+        ///     Outcome of a login sent in AuthResponse. Only <see cref="Success"/> carries a token.
+        /// </summary>
+        public enum AuthStatus : byte
+        {
+            Success = 0,
+            InvalidCredentials = 1,
+            NoGameWorld = 2,
+            ServerBusy = 3,
+            InternalError = 4,
+            RateLimited = 5,
+        }
+
+        public const int TokenLength = 64;
+        public const int HeaderSize = 3;
+        // Fields are prefixed with a u8 length.
+        public const int MaxFieldLength = byte.MaxValue;
+
+        /// <exception cref="System.ArgumentException">Login, password or ip address is longer than <see cref="MaxFieldLength"/> bytes</exception>
+        public static int AuthForwardSize(string login, string password, string ipAddress)
+        {
+            return HeaderSize + 4 + 1 + FieldLength(Encoding.UTF8.GetByteCount(login), nameof(login)) + 1 + FieldLength(Encoding.UTF8.GetByteCount(password), nameof(password)) +
+                1 + FieldLength(ipAddress.Length, nameof(ipAddress));
+        }
+
+        /// <exception cref="System.ArgumentException">Ip address or token is longer than <see cref="MaxFieldLength"/> bytes</exception>
+        public static int AuthResponseSize(string ipAddress, string token)
+        {
+            return HeaderSize + 4 + 1 + 1 + FieldLength(ipAddress.Length, nameof(ipAddress)) + 1 + FieldLength(token.Length, nameof(token));
+        }
+
+        public static int SendTokenSize()
+        {
+            return HeaderSize + TokenLength;
+        }
+
+        /// <summary>
+        ///     Writes AuthForward frame into <paramref name="buffer"/> at <paramref name="offset"/>.
+        ///     <paramref name="buffer"/> must have at least <see cref="AuthForwardSize"/> bytes left.
+        /// </summary>
+        /// <returns>Number of bytes written</returns>
+        /// <exception cref="System.ArgumentException">A field is too long, see <see cref="AuthForwardSize"/></exception>
+        public static int WriteAuthForward(byte[] buffer, int offset, int clientId, string login, string password, string ipAddress)
+        {
+            int size = AuthForwardSize(login, password, ipAddress);
+            int position = WriteHeader(buffer, offset, size - HeaderSize, FrameKind.AuthForward);
+
+            position = WriteInt32(buffer, position, clientId);
+            position = WriteUtf8(buffer, position, login);
+            position = WriteUtf8(buffer, position, password);
+            _ = WriteAscii(buffer, position, ipAddress);
+
+            return size;
+        }
+
+        /// <summary>
+        ///     Writes AuthResponse frame into <paramref name="buffer"/> at <paramref name="offset"/>.
+        ///     <paramref name="buffer"/> must have at least <see cref="AuthResponseSize"/> bytes left.
+        /// </summary>
+        /// <returns>Number of bytes written</returns>
+        /// <exception cref="System.ArgumentException">A field is too long, see <see cref="AuthResponseSize"/></exception>
+        public static int WriteAuthResponse(byte[] buffer, int offset, int clientId, AuthStatus status, string ipAddress, string token)
+        {
+            int size = AuthResponseSize(ipAddress, token);
+            int position = WriteHeader(buffer, offset, size - HeaderSize, FrameKind.AuthResponse);
+
+            position = WriteInt32(buffer, position, clientId);
+            buffer[position++] = (byte)status;
+            position = WriteAscii(buffer, position, ipAddress);
+            _ = WriteAscii(buffer, position, token);
+
+            return size;
+        }
+
+        /// <summary>
+        ///     Writes SendToken frame into <paramref name="buffer"/> at <paramref name="offset"/>.
+        /// </summary>
+        /// <returns>Number of bytes written</returns>
+        public static int WriteSendToken(byte[] buffer, int offset, string token)
+        {
+            int position = WriteHeader(buffer, offset, TokenLength, FrameKind.SendToken);
+
+            for (int i = 0; i < TokenLength; i++)
+            {
+                buffer[position + i] = (byte)token[i];
+            }
+
+            return SendTokenSize();
+        }
+
+        /// <summary>
+        ///     Reads the header of the frame starting at <paramref name="offset"/>.
+        /// </summary>
+        /// <returns><c>false</c> if the frame does not fit in <paramref name="buffer"/></returns>
+        public static bool TryReadHeader(byte[] buffer, int offset, out FrameKind kind, out int bodyLength)
+        {
+            kind = 0;
+            bodyLength = 0;
+
+            if (buffer.Length - offset < HeaderSize) return false;
+
+            bodyLength = buffer[offset] | (buffer[offset + 1] << 8);
+            kind = (FrameKind)buffer[offset + 2];
+
+            return buffer.Length - offset - HeaderSize >= bodyLength;
+        }
+
+        /// <summary>
+        ///     Reads body of an AuthForward frame.
+        /// </summary>
+        /// <returns><c>false</c> if the body is malformed</returns>
+        public static bool TryReadAuthForward(byte[] buffer, int offset, int bodyLength, out int clientId, out string login, out string password, out string ipAddress)
+        {
+            clientId = 0;
+            login = null;
+            password = null;
+            ipAddress = null;
+
+            int end = offset + bodyLength;
+            if (bodyLength < 4) return false;
+
+            clientId = ReadInt32(buffer, offset);
+            int position = offset + 4;
+
+            return TryReadUtf8(buffer, ref position, end, out login) && TryReadUtf8(buffer, ref position, end, out password) &&
+                TryReadUtf8(buffer, ref position, end, out ipAddress) && position == end;
+        }
+
+        /// <summary>
+        ///     Reads body of an AuthResponse frame.
+        /// </summary>
+        /// <returns><c>false</c> if the body is malformed</returns>
+        public static bool TryReadAuthResponse(byte[] buffer, int offset, int bodyLength, out int clientId, out AuthStatus status, out string ipAddress, out string token)
+        {
+            clientId = 0;
+            status = 0;
+            ipAddress = null;
+            token = null;
+
+            int end = offset + bodyLength;
+            if (bodyLength < 5) return false;
+
+            clientId = ReadInt32(buffer, offset);
+            status = (AuthStatus)buffer[offset + 4];
+            int position = offset + 5;
+
+            return TryReadUtf8(buffer, ref position, end, out ipAddress) && TryReadUtf8(buffer, ref position, end, out token) && position == end &&
+                (token.Length == 0 || token.Length == TokenLength);
+        }
+
+        /// <summary>
+        ///     Reads body of a SendToken frame.
+        /// </summary>
+        /// <returns><c>false</c> if the body is malformed</returns>
+        public static bool TryReadSendToken(byte[] buffer, int offset, int bodyLength, out string token)
+        {
+            token = null;
+
+            if (bodyLength != TokenLength) return false;
+
+            token = Encoding.ASCII.GetString(buffer, offset, TokenLength);
+            return true;
+        }
+
+        // Size functions check every field, so the writers can't wrap a length prefix around.
+        private static int FieldLength(int length, string name)
+        {
+            if (length > MaxFieldLength) throw new System.ArgumentException($"Field is {length} bytes long, at most {MaxFieldLength} fit in a frame.", name);
+
+            return length;
+        }
+
+        private static int WriteHeader(byte[] buffer, int offset, int bodyLength, FrameKind kind)
+        {
+            buffer[offset] = (byte)bodyLength;
+            buffer[offset + 1] = (byte)(bodyLength >> 8);
+            buffer[offset + 2] = (byte)kind;
+
+            return offset + HeaderSize;
+        }
+
+        private static int WriteInt32(byte[] buffer, int offset, int value)
+        {
+            buffer[offset] = (byte)value;
+            buffer[offset + 1] = (byte)(value >> 8);
+            buffer[offset + 2] = (byte)(value >> 16);
+            buffer[offset + 3] = (byte)(value >> 24);
+
+            return offset + 4;
+        }
+
+        private static int ReadInt32(byte[] buffer, int offset)
+        {
+            return buffer[offset] | (buffer[offset + 1] << 8) | (buffer[offset + 2] << 16) | (buffer[offset + 3] << 24);
+        }
+
+        private static int WriteAscii(byte[] buffer, int offset, string value)
+        {
+            buffer[offset] = (byte)value.Length;
+            for (int i = 0; i < value.Length; i++)
+            {
+                buffer[offset + 1 + i] = (byte)value[i];
+            }
+
+            return offset + 1 + value.Length;
+        }
+
+        private static int WriteUtf8(byte[] buffer, int offset, string value)
+        {
+            int length = Encoding.UTF8.GetBytes(value, 0, value.Length, buffer, offset + 1);
+            buffer[offset] = (byte)length;
+
+            return offset + 1 + length;
+        }
+
+        private static bool TryReadUtf8(byte[] buffer, ref int position, int end, out string value)
+        {
+            value = null;
+
+            if (position >= end) return false;
+
+            int length = buffer[position];
+            if (end - position - 1 < length) return false;
+
+            value = Encoding.UTF8.GetString(buffer, position + 1, length);
+            position += 1 + length;
+
+            return true;
+        }
+    }
+}
@@ -10,58 +10,126 @@ namespace AuthenticationServer.Scripts.AutoLoad
         public delegate void Connected(bool success);
 
         [Signal]
-        public delegate void FindUserResult(int gatewayId, int clientId, bool exists);
+        public delegate void FindUserResult(int loginId, bool success, bool exists);
 
-        //private readonly MySQL mySQL;
+        private const string FindUserQuery = "SELECT * FROM users WHERE login=? AND password=?";
+
+        // Written behind by the native library, many rows per statement, see RecordLogin.
+        private const string LastLoginInsert = "INSERT INTO last_logins (login, time, ip) VALUES";
+        private const string LastLoginUpsert = " ON DUPLICATE KEY UPDATE time=VALUES(time), ip=VALUES(ip)";
+        private const string AuthAuditInsert = "INSERT INTO auth_audit (login, time, ip, status) VALUES";
+
+        private const int DefaultPort = 3306;
+
+        // Users are split over several databases by login, each shard has its own connections and queue.
+        // Shards are created and freed by the native MySQLShards, only their settings and queries go through here.
+        private readonly DataBaseShards shards;
+        // Every shard registers the write-behind tables in the same order, so the indices are the same on all of them.
+        private int lastLoginTable;
+        private int authAuditTable;
 
         public DataBase()
         {
             _singleton = this;
-            //mySQL = new MySQL();
+            shards = new DataBaseShards();
         }
 
         public override void _Ready()
         {
-            //mySQL.SetCredentials(host: "localhost", username: "root", password: "");
+            shards.SetVirtualNodes(ServerConfiguration.Singleton.GetDataBaseVirtualNodes(128));
+            foreach (string shard in ServerConfiguration.Singleton.GetDataBaseShards("localhost"))
+            {
+                // Hosts are listed as `host` or `host:port`, the shard is named after the entry.
+                string name = shard.Trim();
+                string[] hostPort = name.Split(':');
+                int port = hostPort.Length > 1 && int.TryParse(hostPort[1], out int parsedPort) ? parsedPort : DefaultPort;
+                shards.AddShard(name, hostPort[0], port);
+            }
+
+            shards.SetCredentials(username: "root", password: "");
+            shards.SetPoolSize(ServerConfiguration.Singleton.GetDataBasePoolSize(4));
+            shards.SetCompression(ServerConfiguration.Singleton.GetDataBaseCompression(false), ServerConfiguration.Singleton.GetDataBaseWriteBehindCompression(true));
+            shards.SetSsl(ServerConfiguration.Singleton.GetDataBaseSslMode(2), ServerConfiguration.Singleton.GetDataBaseSslCa(""),
+                ServerConfiguration.Singleton.GetDataBaseSslCert(""), ServerConfiguration.Singleton.GetDataBaseSslKey(""));
+            shards.SetProtocolBuffers(ServerConfiguration.Singleton.GetDataBaseNetBufferLength(0), 0);
+            shards.SetTraceSampling(LoginTracer.Sampling);
 
-            //GD.LogInfo("Starting database thread...");
-            // Seems like it is better to deffer call since `connect_to_database` creates a thread which halts the main thread for a 2-3 seconds
-            //mySQL.CallDeferred("connect_to_database", this, nameof(DataBaseConnected));
+            // Queries over the limit (or, with policy 1, while the queue is standing) are refused right away, see FindUser.
+            shards.SetQueueLimit(ServerConfiguration.Singleton.GetDataBaseQueueLimit(1024));
+            shards.SetAdmissionPolicy(ServerConfiguration.Singleton.GetDataBaseAdmissionPolicy(1),
+                ServerConfiguration.Singleton.GetDataBaseQueueTarget(5), ServerConfiguration.Singleton.GetDataBaseQueueInterval(100));
+
+            shards.SetWriteBehindFlush(ServerConfiguration.Singleton.GetDataBaseWriteBehindInterval(1000),
+                ServerConfiguration.Singleton.GetDataBaseWriteBehindMaxRecords(500), ServerConfiguration.Singleton.GetDataBaseWriteBehindMaxBuffered(100000));
+            lastLoginTable = shards.RegisterWriteBehind(LastLoginInsert, 3, LastLoginUpsert);
+            authAuditTable = shards.RegisterWriteBehind(AuthAuditInsert, 4, "");
+
+            // Prepared on every connection as soon as it opens, so the first login doesn't pay for it.
+            shards.RegisterHotStatement(FindUserQuery);
+
+            //GD.LogInfo("Starting database threads...");
+            // Connections are opened in parallel on the worker threads, a shard is ready as soon as its first one is.
+            // `Connected` is emitted once every shard is connected, a login may go to any of them.
+            WaitForConnection(shards.ConnectToDatabase());
 
             // It's ok to set the schema here since the call will be queued and sent only after connection was successful.
-           // mySQL.SetSchema("nightfall");
+            _ = shards.SetSchema("nightfall");
         }
 
-        public void FindUser(int gatewayId, int clinetId, string login, string password)
+        /// <returns>The queued lookup, or <c>null</c> if the database is overloaded and the query was not queued, <see cref="FindUserResult"/> won't be emitted then</returns>
+        public DataBaseRequest FindUser(int loginId, string login, string password)
         {
-            string query = "SELECT * FROM users WHERE login=? AND password=?";
-            //mySQL.ExecutePreparedSelectQuery(query, new Array { login, password }, this, nameof(FindUserResult), new Array { gatewayId, clinetId });
+            // Login id doubles as the trace id, so spans recorded by the worker threads line up with InternalNetwork's.
+            shards.SetTraceId(loginId);
+            DataBaseRequest request = shards.ExecutePreparedSelectQuery(login, FindUserQuery, new Array { login, password });
+            if (request.Status == DataBaseRequest.RequestStatus.Busy)
+            {
+                return null;
+            }
+
+            WaitForUser(loginId, request);
+            return request;
         }
 
-        private void FindUserResults(bool success, int rows, Array data)
+        /// <summary>
+        ///     Appends the login to the audit log and, if it succeeded, updates the user's last login.
+        ///     Rows are buffered and written in the background, the login doesn't wait for them.
+        /// </summary>
+        public void RecordLogin(string login, string ipAddress, AuthPacketCodec.AuthStatus status)
         {
-#if DEBUG
-            if (data.Count != 2)
+            // Rows go to the shard that owns the user.
+            string time = System.DateTime.UtcNow.ToString("yyyy-MM-dd HH:mm:ss");
+            shards.WriteBehind(login, authAuditTable, new Array { login, time, ipAddress, (int)status });
+            if (status == AuthPacketCodec.AuthStatus.Success)
             {
-                //GD.PrintErr("Argument `data` must have `Count` = 2");
+                shards.WriteBehind(login, lastLoginTable, new Array { login, time, ipAddress });
             }
-            if (!(data[0] is int))
-            {
-               // GD.PrintErr("data[0] must be an int");
-            }
-            if (!(data[1] is int))
-            {
-               // GD.PrintErr("data[1] must be an int");
-            }
-#endif
-            int gatewayId = (int)data[0];
-            int clientId = (int)data[1];
+        }
+
+        /// <summary>
+        ///     Spans recorded by the database worker threads of all shards, as a JSON array of Chrome trace events.
+        /// </summary>
+        public string DumpTrace()
+        {
+            return shards.DumpTrace();
+        }
+
+        private async void WaitForUser(int loginId, DataBaseRequest request)
+        {
+            _ = await request.Completed();
+
+            bool success = request.Status == DataBaseRequest.RequestStatus.Ok;
 
-            EmitSignal(nameof(FindUserResult), gatewayId, clientId, success && rows == 1);
+            // Handlers of the result run inside EmitSignal, on the main thread.
+            ulong callbackUsec = OS.GetTicksUsec();
+            EmitSignal(nameof(FindUserResult), loginId, success, success && request.RowCount == 1);
+            LoginTracer.Record("db_callback", loginId, callbackUsec, OS.GetTicksUsec());
         }
 
-        private void DataBaseConnected(bool success, Array data)
+        private async void WaitForConnection(DataBaseRequest request)
         {
+            bool success = (await request.Completed()).Status == DataBaseRequest.RequestStatus.Ok;
+
            // GD.LogInfo("Database thread is ready!");
             EmitSignal(nameof(Connected), success);
             if (success)
@@ -76,7 +144,7 @@ namespace AuthenticationServer.Scripts.AutoLoad
 
         public override void _ExitTree()
         {
-            //mySQL.Free();
+            shards.Free();
         }
     }
 }
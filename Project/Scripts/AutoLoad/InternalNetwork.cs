@@ -1,5 +1,6 @@
+using System.Collections.Generic;
+
 using Godot;
-using Godot.Collections;
 
 using SharedUtils.Networking;
 
@@ -12,6 +13,53 @@ namespace AuthenticationServer.Scripts.AutoLoad
 {
     public class InternalNetwork : NetworkedServer<InternalNetwork>
     {
+        private const ulong TimeoutTickMsec = 100;
+
+        private LoginRateLimiter loginRateLimiter;
+        private LoginRateLimiter sourceRateLimiter;
+
+        private enum TimeoutKind
+        {
+            PeerHandshake = 1,
+            Token = 2,
+            Login = 3,
+        }
+
+        private struct PendingToken
+        {
+            public int Id;
+            public int GameWorldId;
+        }
+
+        private struct PendingLogin
+        {
+            public int GatewayId;
+            public int ClientId;
+            public string Login;
+            public string IpAddress;
+            public ulong ReceivedUsec;
+            // Cancelled if the login times out, so the query doesn't keep its place in the database queue.
+            public DataBaseRequest Request;
+        }
+
+        // Tokens sent to Game World Servers within the token lifetime, each holds a placement on its Game World Server.
+        private readonly Dictionary<string, PendingToken> pendingTokens = new Dictionary<string, PendingToken>();
+        private readonly Dictionary<int, string> pendingTokensById = new Dictionary<int, string>();
+        private int nextTokenId;
+
+        // Logins waiting for the database.
+        private readonly Dictionary<int, PendingLogin> pendingLogins = new Dictionary<int, PendingLogin>();
+        private int nextLoginId;
+
+        private TimingWheel timeouts;
+        private ulong peerHandshakeTimeoutMsec;
+        private ulong tokenLifetimeMsec;
+        private ulong loginTimeoutMsec;
+
+        // Auth responses and tokens are coalesced per peer, see OutboundBatcher.
+        private OutboundBatcher authResponseBatcher;
+        private OutboundBatcher tokenBatcher;
+
         private InternalNetwork() : base()
         {
             _singleton = this;
@@ -24,21 +72,65 @@ namespace AuthenticationServer.Scripts.AutoLoad
             SetProcess(false);
             _ = DataBase.Singleton.Connect(nameof(DataBase.FindUserResult), this, nameof(DataBaseFindUserResult));
 
+            peerHandshakeTimeoutMsec = (ulong)(int)ProjectSettings.GetSetting("network/limits/tcp/connect_timeout_seconds") * 1000;
+            tokenLifetimeMsec = (ulong)ServerConfiguration.Singleton.GetTokenLifetime(30) * 1000;
+            loginTimeoutMsec = (ulong)ServerConfiguration.Singleton.GetLoginTimeout(10) * 1000;
+            timeouts = new TimingWheel(TimeoutTickMsec, OS.GetTicksMsec(), OnTimeout);
+
+            LoginTracer.Sampling = ServerConfiguration.Singleton.GetTraceSampling(0);
+
+            int batchMaxBytes = ServerConfiguration.Singleton.GetBatchMaxBytes(1200);
+            ulong batchMaxDelayMsec = (ulong)ServerConfiguration.Singleton.GetBatchMaxDelay(0);
+            authResponseBatcher = new OutboundBatcher((peerId, packet) => Send(peerId, PacketType.AuthenticationServerAuthResponse, packet), batchMaxBytes, batchMaxDelayMsec);
+            tokenBatcher = new OutboundBatcher((peerId, packet) => Send(peerId, PacketType.AuthenticationServerSendToken, packet), batchMaxBytes, batchMaxDelayMsec);
+
             int port = ServerConfiguration.Singleton.GetPort(4444);
             int maxGameWorlds = ServerConfiguration.Singleton.GetMaxGameWorlds(3);
             int maxGateways = ServerConfiguration.Singleton.GetMaxGateways(1);
 
+            int rateLimitMaxKeys = ServerConfiguration.Singleton.GetRateLimitMaxKeys(262144);
+            loginRateLimiter = new LoginRateLimiter(rateLimitMaxKeys,
+                ServerConfiguration.Singleton.GetLoginRateLimitBurst(5),
+                ServerConfiguration.Singleton.GetLoginRateLimitPerSecond(1));
+            sourceRateLimiter = new LoginRateLimiter(rateLimitMaxKeys,
+                ServerConfiguration.Singleton.GetSourceRateLimitBurst(10),
+                ServerConfiguration.Singleton.GetSourceRateLimitPerSecond(2));
+
             // Wait for database before accepting any connections.
+            GD.Print($"Waiting for database, {OS.GetTicksMsec()} ms since start.");
             var ret = await ToSignal(DataBase.Singleton, nameof(DataBase.Connected));
-            GD.Print(ret);
+            GD.Print($"Database connected (success: {ret[0]}), {OS.GetTicksMsec()} ms since start.");
 
             _ = CreateServer(port, maxClients: maxGameWorlds + maxGateways);
             base._Ready();
             SetProcess(true);
+            GD.Print($"Accepting connections, {OS.GetTicksMsec()} ms since start.");
+        }
+
+        public override void _Process(float delta)
+        {
+            base._Process(delta);
+
+            ulong now = OS.GetTicksMsec();
+            timeouts.Advance(now);
+
+            // Timeouts may have queued responses too, so flush after them.
+            authResponseBatcher.Flush(now);
+            tokenBatcher.Flush(now);
         }
 
         protected override void OnPacketReceived(PacketType packetType, params object[] args)
         {
+            // Login forwards are encoded with AuthPacketCodec and carried as a single byte array.
+            if (packetType == PacketType.GatewayServerAuthForward)
+            {
+                if (args.Length == 1 && args[0] is byte[] buffer)
+                {
+                    ReadAuthForwards(buffer);
+                }
+                return;
+            }
+
             {
                 var packetArgsCountValidator = new PacketArgsCountValidator();
 
@@ -60,7 +152,7 @@ namespace AuthenticationServer.Scripts.AutoLoad
                         }
 
                         //GD.LogInfo("Gateway has been authenticated.");
-                        RemoveTimerForPeer(RpcSenderId);
+                        _ = timeouts.Cancel(TimeoutKey(TimeoutKind.PeerHandshake, RpcSenderId));
 
                         SubServersContainer.Singleton.AddGateway(RpcSenderId);
                         break;
@@ -78,19 +170,10 @@ namespace AuthenticationServer.Scripts.AutoLoad
                         }
 
                         //GD.LogInfo("Game Server has been authenticated.");
-                        RemoveTimerForPeer(RpcSenderId);
+                        _ = timeouts.Cancel(TimeoutKey(TimeoutKind.PeerHandshake, RpcSenderId));
 
                         SubServersContainer.Singleton.AddGameWorld(RpcSenderId);
 
-                        break;
-                    }
-                case PacketType.GatewayServerAuthForward:
-                    {
-                        if (!(args[0] is int clientId)) return;
-                        if (!(args[1] is string login)) return;
-                        if (!(args[2] is string password)) return;
-
-                        DataBase.Singleton.FindUser(RpcSenderId, clientId, login, password); //gateway id too
                         break;
                     }
                 default:
@@ -98,91 +181,251 @@ namespace AuthenticationServer.Scripts.AutoLoad
             }
         }
 
-        private void DataBaseFindUserResult(int gatewayId, int clientId, bool exists)
+        private void ReadAuthForwards(byte[] buffer)
         {
-            // TODO: instead of sending bool to a client a status code should be sent (correct, wrong username/password, no game worlds, internal error ("please try again later" or sth))
-            int optimalGameWorldId = SubServersContainer.Singleton.OptimalGameWorldId;
+            if (!SubServersContainer.Singleton.GatewayExists(RpcSenderId)) return;
+
+            int offset = 0;
+            while (offset < buffer.Length)
+            {
+                if (!AuthPacketCodec.TryReadHeader(buffer, offset, out AuthPacketCodec.FrameKind kind, out int bodyLength)) return;
+
+                int bodyOffset = offset + AuthPacketCodec.HeaderSize;
+                offset = bodyOffset + bodyLength;
 
-            string token = exists ? TokenGenerator.GetUniqueKey(64) : "";
-            string ipAddressOfOptimalGameWorld = exists && optimalGameWorldId != -1 ? GetIpAddressOfPeer(optimalGameWorldId) : "";
+                if (kind != AuthPacketCodec.FrameKind.AuthForward) continue;
+                if (!AuthPacketCodec.TryReadAuthForward(buffer, bodyOffset, bodyLength, out int clientId, out string login, out string password, out string ipAddress)) continue;
 
-            SendTokenToGateway(gatewayId, clientId, ipAddressOfOptimalGameWorld, token);
+                ForwardLogin(RpcSenderId, clientId, login, password, ipAddress);
+            }
+        }
+
+        private void ForwardLogin(int gatewayId, int clientId, string login, string password, string ipAddress)
+        {
+            ulong receivedUsec = OS.GetTicksUsec();
+
+            // Reject floods before they turn into database queries.
+            // Source is the client ip, so reconnecting doesn't reset the limit. Its token is given back if the login is throttled.
+            bool allowed = sourceRateLimiter.TryAcquire(ipAddress);
+            if (allowed && !loginRateLimiter.TryAcquire(login))
+            {
+                sourceRateLimiter.Release(ipAddress);
+                allowed = false;
+            }
 
-            // empty token means client sent wrong credentials and there is no sense in seding empty one.
-            if (token.Length != 0 && optimalGameWorldId != -1)
+            // Not audited, a flood would otherwise turn into as many audit rows as it would have been queries.
+            if (!allowed)
             {
+                SendStatusToGateway(gatewayId, clientId, AuthPacketCodec.AuthStatus.RateLimited);
+                return;
+            }
+
+            int loginId = nextLoginId++;
+
+            // Ends where the lookup starts, so the time spent queueing the query is left to the database spans.
+            LoginTracer.Record("gateway_receive", loginId, receivedUsec, OS.GetTicksUsec());
+
+            // Overloaded database refuses the query at once, so the client can retry instead of waiting for the login timeout.
+            DataBaseRequest request = DataBase.Singleton.FindUser(loginId, login, password);
+            if (request == null)
+            {
+                SendStatusToGateway(gatewayId, clientId, AuthPacketCodec.AuthStatus.ServerBusy);
+                DataBase.Singleton.RecordLogin(login, ipAddress, AuthPacketCodec.AuthStatus.ServerBusy);
+                return;
+            }
+
+            // FindUserResult is emitted on a later frame at the earliest, so the login is pending by then.
+            pendingLogins.Add(loginId, new PendingLogin { GatewayId = gatewayId, ClientId = clientId, Login = login, IpAddress = ipAddress, ReceivedUsec = receivedUsec, Request = request });
+            timeouts.Arm(TimeoutKey(TimeoutKind.Login, loginId), loginTimeoutMsec);
+        }
+
+        private void DataBaseFindUserResult(int loginId, bool success, bool exists)
+        {
+            // Login has already timed out and the client got its answer.
+            if (!pendingLogins.TryGetValue(loginId, out PendingLogin pendingLogin)) return;
+
+            _ = pendingLogins.Remove(loginId);
+            _ = timeouts.Cancel(TimeoutKey(TimeoutKind.Login, loginId));
+
+            int gatewayId = pendingLogin.GatewayId;
+            int clientId = pendingLogin.ClientId;
+            ulong resultUsec = OS.GetTicksUsec();
+
+            int optimalGameWorldId = exists ? SubServersContainer.Singleton.ReservePlacement() : -1;
+
+            AuthPacketCodec.AuthStatus status;
+            if (!success) status = AuthPacketCodec.AuthStatus.InternalError;
+            else if (!exists) status = AuthPacketCodec.AuthStatus.InvalidCredentials;
+            else if (optimalGameWorldId == -1) status = AuthPacketCodec.AuthStatus.NoGameWorld;
+            else status = AuthPacketCodec.AuthStatus.Success;
+
+            string token = status == AuthPacketCodec.AuthStatus.Success ? TokenGenerator.GetUniqueKey(64) : "";
+            string ipAddressOfOptimalGameWorld = status == AuthPacketCodec.AuthStatus.Success ? GetIpAddressOfPeer(optimalGameWorldId) : "";
+
+            ulong tokenUsec = OS.GetTicksUsec();
+            LoginTracer.Record("token_generation", loginId, resultUsec, tokenUsec);
+
+            SendTokenToGateway(gatewayId, clientId, status, ipAddressOfOptimalGameWorld, token);
+            DataBase.Singleton.RecordLogin(pendingLogin.Login, pendingLogin.IpAddress, status);
+
+            // Only a successful login has a token the Game World Server has to know about.
+            if (status == AuthPacketCodec.AuthStatus.Success)
+            {
+                int tokenId = nextTokenId++;
+                pendingTokens.Add(token, new PendingToken { Id = tokenId, GameWorldId = optimalGameWorldId });
+                pendingTokensById.Add(tokenId, token);
+                timeouts.Arm(TimeoutKey(TimeoutKind.Token, tokenId), tokenLifetimeMsec);
+
                 SendTokenToGameWorld(optimalGameWorldId, token);
             }
+
+            ulong sentUsec = OS.GetTicksUsec();
+            LoginTracer.Record("send_response", loginId, tokenUsec, sentUsec);
+            LoginTracer.Record("login", loginId, pendingLogin.ReceivedUsec, sentUsec);
+        }
+
+        /// <summary>
+        ///     Writes spans of sampled logins, including the database worker threads, to <paramref name="path"/> as Chrome trace JSON.
+        /// </summary>
+        public Error DumpTrace(string path = "user://login_trace.json")
+        {
+            var file = new File();
+            Error error = file.Open(path, File.ModeFlags.Write);
+            if (error != Error.Ok) return error;
+
+            file.StoreString(LoginTracer.ToChromeTrace(DataBase.Singleton.DumpTrace()));
+            file.Close();
+
+            return Error.Ok;
         }
 
         /// <summary>
         ///     Sends a temporary token to Gateway Server which is going to forward it to the Client. 
         ///     The lifetime of the token is managed by appropraite Game World Server 
         ///     (this implies that one of the Game World Server must receive the token).
+        ///     The response is batched with other responses to the same Gateway Server and sent on the next flush.
         /// </summary>
         /// <param name="gatewayId">Id of the gateway that issued <see cref="PacketType.GatewayServerAuthForward"/></param>
         /// <param name="clientId">Id of the client that sent login credentials to Gateway Server</param>
+        /// <param name="status">Outcome of the login, the token is empty unless it is <see cref="AuthPacketCodec.AuthStatus.Success"/></param>
         /// <param name="ipAddressOfOptimalGameWorld">Ip address of a Game World Server that is least crowded</param>
         /// <param name="token">64 length string. See <see cref="TokenGenerator"/> to make one</param>
-        private void SendTokenToGateway(int gatewayId, int clientId, string ipAddressOfOptimalGameWorld, string token)
+        private void SendTokenToGateway(int gatewayId, int clientId, AuthPacketCodec.AuthStatus status, string ipAddressOfOptimalGameWorld, string token)
+        {
+            int size = AuthPacketCodec.AuthResponseSize(ipAddressOfOptimalGameWorld, token);
+            int offset = authResponseBatcher.Reserve(gatewayId, size, OS.GetTicksMsec(), out byte[] buffer);
+
+            _ = AuthPacketCodec.WriteAuthResponse(buffer, offset, clientId, status, ipAddressOfOptimalGameWorld, token);
+        }
+
+        /// <summary>
+        ///     Answers a login that failed without a token.
+        /// </summary>
+        private void SendStatusToGateway(int gatewayId, int clientId, AuthPacketCodec.AuthStatus status)
         {
-            Send(gatewayId, PacketType.AuthenticationServerAuthResponse, clientId, ipAddressOfOptimalGameWorld, token);
+            SendTokenToGateway(gatewayId, clientId, status, "", "");
         }
 
         /// <summary>
         ///     Sends a token to Game World Server with id <paramref name="gameWorldId"/>.
         ///     That Game World Server manages the lifetime of that token.
+        ///     The token is batched with other tokens to the same Game World Server and sent on the next flush.
         /// </summary>
         /// <param name="gameWorldId">If of a Game World Server</param>
         /// <param name="token">64 length string. See <see cref="TokenGenerator"/> to make one</param>
         private void SendTokenToGameWorld(int gameWorldId, string token)
         {
-            Send(gameWorldId, PacketType.AuthenticationServerSendToken, token);
-        }
-
-        private void SpawnTimerForPeer(int peerId)
-        {
-            var timer = new Timer
-            {
-                Name = peerId.ToString(),
-                WaitTime = (int)ProjectSettings.GetSetting("network/limits/tcp/connect_timeout_seconds"),
-                Autostart = true,
-                OneShot = true
-            };
+            int offset = tokenBatcher.Reserve(gameWorldId, AuthPacketCodec.SendTokenSize(), OS.GetTicksMsec(), out byte[] buffer);
 
-            _ = timer.Connect("timeout", this, nameof(TimerTimeout), new Array { peerId }, (int)ConnectFlags.Oneshot);
-            AddChild(timer);
+            _ = AuthPacketCodec.WriteSendToken(buffer, offset, token);
         }
 
-        private void RemoveTimerForPeer(int peerId)
+        private static long TimeoutKey(TimeoutKind kind, int id)
         {
-            GetNodeOrNull(peerId.ToString())?.QueueFree();
+            return ((long)kind << 32) | (uint)id;
         }
 
-        private void TimerTimeout(int peerId)
+        private void OnTimeout(long key)
         {
-            if (!SubServersContainer.Singleton.Exists(peerId))
+            int id = (int)key;
+
+            switch ((TimeoutKind)(key >> 32))
             {
-                DisconnectPeer(peerId);
+                case TimeoutKind.PeerHandshake:
+                    {
+                        if (!SubServersContainer.Singleton.Exists(id))
+                        {
+                            DisconnectPeer(id);
+                        }
+                        break;
+                    }
+                case TimeoutKind.Token:
+                    {
+                        if (!pendingTokensById.TryGetValue(id, out string token)) return;
+
+                        PendingToken pendingToken = pendingTokens[token];
+                        RemovePendingToken(token, pendingToken);
+                        SubServersContainer.Singleton.CancelPlacement(pendingToken.GameWorldId);
+                        break;
+                    }
+                case TimeoutKind.Login:
+                    {
+                        if (!pendingLogins.TryGetValue(id, out PendingLogin pendingLogin)) return;
+
+                        _ = pendingLogins.Remove(id);
+                        // A query still in the queue is dropped, one already running completes and its result is ignored.
+                        _ = pendingLogin.Request.Cancel();
+                        SendStatusToGateway(pendingLogin.GatewayId, pendingLogin.ClientId, AuthPacketCodec.AuthStatus.ServerBusy);
+                        DataBase.Singleton.RecordLogin(pendingLogin.Login, pendingLogin.IpAddress, AuthPacketCodec.AuthStatus.ServerBusy);
+                        break;
+                    }
+                default:
+                    break;
             }
+        }
 
-            RemoveTimerForPeer(peerId);
+        private void RemovePendingToken(string token, PendingToken pendingToken)
+        {
+            _ = pendingTokens.Remove(token);
+            _ = pendingTokensById.Remove(pendingToken.Id);
+            _ = timeouts.Cancel(TimeoutKey(TimeoutKind.Token, pendingToken.Id));
         }
 
         protected override void PeerConnected(int id)
         {
             //GD.LogInfo($"Peer {id} connected");
-            SpawnTimerForPeer(id);
+            timeouts.Arm(TimeoutKey(TimeoutKind.PeerHandshake, id), peerHandshakeTimeoutMsec);
         }
 
         protected override void PeerDisconnected(int id)
         {
             //GD.LogInfo($"Peer {id} disconnected");
-            RemoveTimerForPeer(id);
+            _ = timeouts.Cancel(TimeoutKey(TimeoutKind.PeerHandshake, id));
+            authResponseBatcher.Remove(id);
+            tokenBatcher.Remove(id);
+
+            if (SubServersContainer.Singleton.GameWorldExists(id))
+            {
+                RemovePendingTokensOf(id);
+            }
 
             _ = SubServersContainer.Singleton.Remove(id);
         }
 
+        private void RemovePendingTokensOf(int gameWorldId)
+        {
+            var tokens = new List<string>();
+            foreach (var pair in pendingTokens)
+            {
+                if (pair.Value.GameWorldId == gameWorldId) tokens.Add(pair.Key);
+            }
+
+            foreach (string token in tokens)
+            {
+                RemovePendingToken(token, pendingTokens[token]);
+            }
+        }
+
         protected override string GetCryptoKeyName()
         {
             return "ag.key";
@@ -36,6 +36,145 @@ namespace AuthenticationServer.Scripts.AutoLoad
             return GetValue<int>("NETWORKING", "max_game_worlds", defaultMaxGameWorlds);
         }
 
+        public int GetDataBasePoolSize(int defaultPoolSize)
+        {
+            return GetValue<int>("DATABASE", "pool_size", defaultPoolSize);
+        }
+
+        public bool GetDataBaseCompression(bool defaultCompression)
+        {
+            return GetValue<bool>("DATABASE", "compression", defaultCompression);
+        }
+
+        public bool GetDataBaseWriteBehindCompression(bool defaultCompression)
+        {
+            return GetValue<bool>("DATABASE", "write_behind_compression", defaultCompression);
+        }
+
+        public int GetDataBaseSslMode(int defaultSslMode)
+        {
+            return GetValue<int>("DATABASE", "ssl_mode", defaultSslMode);
+        }
+
+        public string GetDataBaseSslCa(string defaultPath)
+        {
+            return GetValue<string>("DATABASE", "ssl_ca", defaultPath);
+        }
+
+        public string GetDataBaseSslCert(string defaultPath)
+        {
+            return GetValue<string>("DATABASE", "ssl_cert", defaultPath);
+        }
+
+        public string GetDataBaseSslKey(string defaultPath)
+        {
+            return GetValue<string>("DATABASE", "ssl_key", defaultPath);
+        }
+
+        public int GetDataBaseNetBufferLength(int defaultLength)
+        {
+            return GetValue<int>("DATABASE", "net_buffer_length", defaultLength);
+        }
+
+        public int GetDataBaseQueueLimit(int defaultLimit)
+        {
+            return GetValue<int>("DATABASE", "queue_limit", defaultLimit);
+        }
+
+        public int GetDataBaseAdmissionPolicy(int defaultPolicy)
+        {
+            return GetValue<int>("DATABASE", "admission_policy", defaultPolicy);
+        }
+
+        public int GetDataBaseQueueTarget(int defaultMsec)
+        {
+            return GetValue<int>("DATABASE", "queue_target_msec", defaultMsec);
+        }
+
+        public int GetDataBaseQueueInterval(int defaultMsec)
+        {
+            return GetValue<int>("DATABASE", "queue_interval_msec", defaultMsec);
+        }
+
+        public int GetDataBaseWriteBehindInterval(int defaultMsec)
+        {
+            return GetValue<int>("DATABASE", "write_behind_interval_msec", defaultMsec);
+        }
+
+        public int GetDataBaseWriteBehindMaxRecords(int defaultMaxRecords)
+        {
+            return GetValue<int>("DATABASE", "write_behind_max_records", defaultMaxRecords);
+        }
+
+        public int GetDataBaseWriteBehindMaxBuffered(int defaultMaxBuffered)
+        {
+            return GetValue<int>("DATABASE", "write_behind_max_buffered", defaultMaxBuffered);
+        }
+
+        /// <summary>
+        ///     Hosts of the users table shards, comma separated.
+        ///     Shards are placed on the hash ring by host, so keep the names stable when adding one.
+        /// </summary>
+        public string[] GetDataBaseShards(string defaultHosts)
+        {
+            return GetValue<string>("DATABASE", "shards", defaultHosts).Split(new[] { ',' }, System.StringSplitOptions.RemoveEmptyEntries);
+        }
+
+        public int GetDataBaseVirtualNodes(int defaultVirtualNodes)
+        {
+            return GetValue<int>("DATABASE", "virtual_nodes", defaultVirtualNodes);
+        }
+
+        public int GetTraceSampling(int defaultSampling)
+        {
+            return GetValue<int>("TRACING", "sampling", defaultSampling);
+        }
+
+        public int GetTokenLifetime(int defaultSeconds)
+        {
+            return GetValue<int>("NETWORKING", "token_lifetime_seconds", defaultSeconds);
+        }
+
+        public int GetLoginTimeout(int defaultSeconds)
+        {
+            return GetValue<int>("NETWORKING", "login_timeout_seconds", defaultSeconds);
+        }
+
+        public int GetBatchMaxBytes(int defaultMaxBytes)
+        {
+            return GetValue<int>("BATCHING", "max_bytes", defaultMaxBytes);
+        }
+
+        public int GetBatchMaxDelay(int defaultMsec)
+        {
+            return GetValue<int>("BATCHING", "max_delay_msec", defaultMsec);
+        }
+
+        public int GetRateLimitMaxKeys(int defaultMaxKeys)
+        {
+            return GetValue<int>("RATE_LIMIT", "max_keys", defaultMaxKeys);
+        }
+
+        public int GetLoginRateLimitBurst(int defaultBurst)
+        {
+            return GetValue<int>("RATE_LIMIT", "login_burst", defaultBurst);
+        }
+
+        public int GetLoginRateLimitPerSecond(int defaultPerSecond)
+        {
+            return GetValue<int>("RATE_LIMIT", "login_per_second", defaultPerSecond);
+        }
+
+        public int GetSourceRateLimitBurst(int defaultBurst)
+        {
+            return GetValue<int>("RATE_LIMIT", "source_burst", defaultBurst);
+        }
+
+        public int GetSourceRateLimitPerSecond(int defaultPerSecond)
+        {
+            return GetValue<int>("RATE_LIMIT", "source_per_second", defaultPerSecond);
+        }
+
         public override void _ExitTree()
         {
             var error = SaveConfiguration();
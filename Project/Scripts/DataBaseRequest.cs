@@ -0,0 +1,64 @@
+using System.Threading.Tasks;
+
+using Godot;
+
+namespace AuthenticationServer
+{
+    /// <summary>
+    ///     Typed accessor of a MySQLRequest handle returned by the native MySQL library.
+    ///     Status and row count arrive as arguments of its `completed` signal, so reading them after
+    ///     <see cref="Completed"/> doesn't call into the library by name.
+    /// </summary>
+    public sealed class DataBaseRequest
+    {
+        // Values of MySQLRequest::Status in the native library.
+        public enum RequestStatus
+        {
+            Pending = 0,
+            Running = 1,
+            Ok = 2,
+            Failed = 3,
+            Busy = 4,
+            Cancelled = 5,
+        }
+
+        private readonly Reference request;
+        private RequestStatus? completedStatus;
+
+        public DataBaseRequest(Reference request)
+        {
+            this.request = request;
+        }
+
+        /// <summary>
+        ///     Requests refused by admission control are <see cref="RequestStatus.Busy"/> as soon as the call returns them,
+        ///     before <see cref="Completed"/> finishes.
+        /// </summary>
+        public RequestStatus Status => completedStatus ?? (RequestStatus)System.Convert.ToInt32(request.Call("get_status"));
+
+        public long RowCount { get; private set; }
+
+        /// <summary>
+        ///     Takes the request out of the queue if no worker started it yet, it then completes as <see cref="RequestStatus.Cancelled"/>.
+        /// </summary>
+        /// <returns><c>false</c> if it is already running or completed</returns>
+        public bool Cancel()
+        {
+            return (bool)request.Call("cancel");
+        }
+
+        /// <summary>
+        ///     Waits for `completed`. It is emitted on the next idle frame after the request completed,
+        ///     so call this in the frame the request was made in.
+        /// </summary>
+        public async Task<DataBaseRequest> Completed()
+        {
+            object[] args = await request.ToSignal(request, "completed");
+
+            completedStatus = (RequestStatus)System.Convert.ToInt32(args[0]);
+            RowCount = System.Convert.ToInt64(args[1]);
+
+            return this;
+        }
+    }
+}
@@ -0,0 +1,140 @@
+using Godot;
+using Godot.Collections;
+
+namespace AuthenticationServer
+{
+    /// <summary>
+    ///     Typed accessor of the native MySQLShards. It creates the MySQL instance of every shard and frees them with itself,
+    ///     scripts reach them only through the methods below. Settings apply to the shards added so far, so add every shard first.
+    /// </summary>
+    public sealed class DataBaseShards
+    {
+        private const string ScriptPath = "res://Bin/mysql_shards.gdns";
+
+        private readonly Object shards;
+
+        public DataBaseShards()
+        {
+            shards = GD.Load<NativeScript>(ScriptPath).New();
+        }
+
+        public void SetVirtualNodes(int virtualNodes)
+        {
+            _ = shards.Call("set_virtual_nodes", virtualNodes);
+        }
+
+        public void AddShard(string name, string host, int port)
+        {
+            _ = shards.Call("add_shard", name, host, port);
+        }
+
+        public void SetCredentials(string username, string password)
+        {
+            _ = shards.Call("set_credentials", username, password);
+        }
+
+        public void SetPoolSize(int size)
+        {
+            _ = shards.Call("set_pool_size", size);
+        }
+
+        public void SetCompression(bool workers, bool writeBehind)
+        {
+            _ = shards.Call("set_compression", workers, writeBehind);
+        }
+
+        public void SetSsl(int mode, string ca, string cert, string key)
+        {
+            _ = shards.Call("set_ssl", mode, ca, cert, key);
+        }
+
+        public void SetProtocolBuffers(int netBufferLength, int maxAllowedPacket)
+        {
+            _ = shards.Call("set_protocol_buffers", netBufferLength, maxAllowedPacket);
+        }
+
+        public void RegisterHotStatement(string query)
+        {
+            _ = shards.Call("register_hot_statement", query);
+        }
+
+        public void SetQueueLimit(int limit)
+        {
+            _ = shards.Call("set_queue_limit", limit);
+        }
+
+        public void SetAdmissionPolicy(int policy, int targetMsec, int intervalMsec)
+        {
+            _ = shards.Call("set_admission_policy", policy, targetMsec, intervalMsec);
+        }
+
+        public void SetTraceSampling(int oneIn)
+        {
+            _ = shards.Call("set_trace_sampling", oneIn);
+        }
+
+        /// <returns>Index of the table for <see cref="WriteBehind"/>, the same on every shard</returns>
+        public int RegisterWriteBehind(string insert, int columns, string suffix)
+        {
+            return System.Convert.ToInt32(shards.Call("register_write_behind", insert, columns, suffix));
+        }
+
+        public void SetWriteBehindFlush(int intervalMsec, int maxRecords, int maxBuffered)
+        {
+            _ = shards.Call("set_write_behind_flush", intervalMsec, maxRecords, maxBuffered);
+        }
+
+        /// <summary>
+        ///     Completes once every shard completed, <see cref="DataBaseRequest.RequestStatus.Ok"/> only if all of them connected.
+        /// </summary>
+        public DataBaseRequest ConnectToDatabase()
+        {
+            return new DataBaseRequest((Reference)shards.Call("connect_to_database"));
+        }
+
+        public DataBaseRequest SetSchema(string schema)
+        {
+            return new DataBaseRequest((Reference)shards.Call("set_schema", schema));
+        }
+
+        /// <summary>
+        ///     Identifies the next query in the dumped trace, on whichever shard it runs.
+        /// </summary>
+        public void SetTraceId(int traceId)
+        {
+            _ = shards.Call("set_trace_id", traceId);
+        }
+
+        /// <summary>
+        ///     Runs the query on the shard that owns <paramref name="key"/>.
+        /// </summary>
+        public DataBaseRequest ExecutePreparedSelectQuery(string key, string query, Array parameters)
+        {
+            return new DataBaseRequest((Reference)shards.Call("execute_prepared_select_query", key, query, parameters));
+        }
+
+        /// <summary>
+        ///     Buffers the row on the shard that owns <paramref name="key"/>, it is inserted in the background.
+        /// </summary>
+        public void WriteBehind(string key, int table, Array values)
+        {
+            _ = shards.Call("write_behind", key, table, values);
+        }
+
+        /// <summary>
+        ///     Spans recorded by the worker threads of all shards, as a JSON array of Chrome trace events.
+        /// </summary>
+        public string DumpTrace()
+        {
+            return (string)shards.Call("dump_trace");
+        }
+
+        /// <summary>
+        ///     Frees the shards too, each of them joins its worker threads.
+        /// </summary>
+        public void Free()
+        {
+            shards.Free();
+        }
+    }
+}
@@ -3,5 +3,28 @@ namespace AuthenticationServer
 {
     public class GameWorld
     {
+        public int PeerId { get; }
+
+        /// <summary>
+        ///     Number of players placed on this Game World Server whose tokens have not expired yet.
+        ///     Game World Servers don't report their player count, so this only ranks them for placement.
+        ///     It is not occupancy and never refuses a login.
+        /// </summary>
+        public int ReservedCount { get; set; }
+
+        /// <summary>
+        ///     Position in <see cref="GameWorldScheduler"/>'s heap, -1 when not scheduled.
+        /// </summary>
+        internal int HeapIndex { get; set; } = -1;
+
+        public GameWorld(int peerId)
+        {
+            PeerId = peerId;
+        }
+
+        internal bool IsLessLoadedThan(GameWorld other)
+        {
+            return ReservedCount < other.ReservedCount || (ReservedCount == other.ReservedCount && PeerId < other.PeerId);
+        }
     }
-}
\ No newline at end of file
+}
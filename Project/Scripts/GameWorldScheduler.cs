@@ -0,0 +1,103 @@
+using System.Collections.Generic;
+
+namespace AuthenticationServer
+{
+    /// <summary>
+    ///     Min-heap of Game World Servers ordered by their reservations.
+    ///     Every operation is O(log n), the least loaded Game World Server is always at the top.
+    /// </summary>
+    public sealed class GameWorldScheduler
+    {
+        private readonly List<GameWorld> heap = new List<GameWorld>();
+
+        public int Count => heap.Count;
+
+        public void Add(GameWorld gameWorld)
+        {
+            gameWorld.HeapIndex = heap.Count;
+            heap.Add(gameWorld);
+            SiftUp(gameWorld.HeapIndex);
+        }
+
+        public void Remove(GameWorld gameWorld)
+        {
+            int index = gameWorld.HeapIndex;
+            if (index < 0) return;
+
+            int last = heap.Count - 1;
+            Swap(index, last);
+            heap.RemoveAt(last);
+            gameWorld.HeapIndex = -1;
+
+            if (index < heap.Count)
+            {
+                Update(heap[index]);
+            }
+        }
+
+        /// <summary>
+        ///     Restores heap order after load of <paramref name="gameWorld"/> changed.
+        /// </summary>
+        public void Update(GameWorld gameWorld)
+        {
+            if (gameWorld.HeapIndex < 0) return;
+
+            SiftUp(gameWorld.HeapIndex);
+            SiftDown(gameWorld.HeapIndex);
+        }
+
+        /// <summary>
+        ///     Reserves a slot on the least loaded Game World Server.
+        /// </summary>
+        /// <returns>Reserved Game World Server or <c>null</c> if there is none</returns>
+        public GameWorld Reserve()
+        {
+            if (heap.Count == 0) return null;
+
+            GameWorld gameWorld = heap[0];
+            gameWorld.ReservedCount++;
+            SiftDown(0);
+
+            return gameWorld;
+        }
+
+        private void SiftUp(int index)
+        {
+            while (index > 0)
+            {
+                int parent = (index - 1) / 2;
+                if (!heap[index].IsLessLoadedThan(heap[parent])) break;
+
+                Swap(index, parent);
+                index = parent;
+            }
+        }
+
+        private void SiftDown(int index)
+        {
+            while (true)
+            {
+                int left = 2 * index + 1;
+                int right = left + 1;
+                int smallest = index;
+
+                if (left < heap.Count && heap[left].IsLessLoadedThan(heap[smallest])) smallest = left;
+                if (right < heap.Count && heap[right].IsLessLoadedThan(heap[smallest])) smallest = right;
+                if (smallest == index) break;
+
+                Swap(index, smallest);
+                index = smallest;
+            }
+        }
+
+        private void Swap(int a, int b)
+        {
+            GameWorld temp = heap[a];
+            heap[a] = heap[b];
+            heap[b] = temp;
+
+            heap[a].HeapIndex = a;
+            heap[b].HeapIndex = b;
+        }
+    }
+}
@@ -0,0 +1,179 @@
+using System.Collections.Concurrent;
+using System.Diagnostics;
+using System.Threading;
+
+namespace AuthenticationServer
+{
+    /// <summary>
+    ///     Token bucket rate limiter for login attempts. Every key (a login or a client ip) has a bucket of its own,
+    ///     so attempts on one key never drain another. A check never takes a lock: state of a bucket is swapped with
+    ///     a single CAS and only the first attempt of a key allocates its bucket.
+    ///     Buckets that have refilled completely hold no state worth keeping and are evicted once the limiter
+    ///     reaches its maximum number of keys.
+    /// </summary>
+    public sealed class LoginRateLimiter
+    {
+        private sealed class Bucket
+        {
+            // Upper 32 bits: available tokens in thousandths of a token.
+            // Lower 32 bits: timestamp of the last refill in milliseconds.
+            public long State;
+        }
+
+        private const int TokenScale = 1000;
+
+        // State of a bucket that was evicted, attempts that still hold it look the key up again.
+        private const long Evicted = -1;
+
+        private static readonly Stopwatch clock = Stopwatch.StartNew();
+
+        private readonly ConcurrentDictionary<string, Bucket> buckets = new ConcurrentDictionary<string, Bucket>();
+        private readonly int maxKeys;
+        private readonly int capacity;
+        private readonly int refillPerSecond;
+
+        // ConcurrentDictionary.Count takes every lock, so the number of buckets is counted here.
+        private int count;
+        private int sweeping;
+        private long nextSweepMsec;
+
+        /// <param name="maxKeys">Number of keys tracked at once, new keys are rejected while every tracked one is still throttled</param>
+        /// <param name="burst">Number of attempts a key can make at once</param>
+        /// <param name="refillPerSecond">Number of attempts a key regains every second</param>
+        public LoginRateLimiter(int maxKeys, int burst, int refillPerSecond)
+        {
+            this.maxKeys = maxKeys;
+            capacity = burst * TokenScale;
+            this.refillPerSecond = refillPerSecond > 0 ? refillPerSecond : 1;
+        }
+
+        public int Count => Volatile.Read(ref count);
+
+        /// <summary>
+        ///     Takes one token from the bucket of <paramref name="key"/>.
+        /// </summary>
+        /// <returns><c>true</c> if the attempt is allowed, <c>false</c> if it should be rejected</returns>
+        public bool TryAcquire(string key)
+        {
+            while (true)
+            {
+                Bucket bucket = GetBucket(key);
+                if (bucket == null) return false;
+
+                ref long state = ref bucket.State;
+                long current = Volatile.Read(ref state);
+                if (current == Evicted) continue;
+
+                uint now = Now();
+                long refilled = Refill(current, now);
+                if (refilled < TokenScale)
+                {
+                    return false;
+                }
+
+                long next = Pack((int)refilled - TokenScale, now);
+                if (Interlocked.CompareExchange(ref state, next, current) == current)
+                {
+                    return true;
+                }
+            }
+        }
+
+        /// <summary>
+        ///     Gives back the token taken by <see cref="TryAcquire"/> of an attempt that was rejected by another check after all.
+        /// </summary>
+        public void Release(string key)
+        {
+            if (!buckets.TryGetValue(key, out Bucket bucket)) return;
+
+            ref long state = ref bucket.State;
+            while (true)
+            {
+                long current = Volatile.Read(ref state);
+                if (current == Evicted) return;
+
+                uint now = Now();
+                long refilled = Refill(current, now) + TokenScale;
+                if (refilled > capacity)
+                {
+                    refilled = capacity;
+                }
+
+                if (Interlocked.CompareExchange(ref state, Pack((int)refilled, now), current) == current) return;
+            }
+        }
+
+        private Bucket GetBucket(string key)
+        {
+            if (buckets.TryGetValue(key, out Bucket bucket)) return bucket;
+
+            if (Volatile.Read(ref count) >= maxKeys)
+            {
+                Sweep();
+                if (Volatile.Read(ref count) >= maxKeys) return null;
+            }
+
+            var created = new Bucket { State = Pack(capacity, Now()) };
+            bucket = buckets.GetOrAdd(key, created);
+            if (bucket == created)
+            {
+                _ = Interlocked.Increment(ref count);
+            }
+
+            return bucket;
+        }
+
+        /// <summary>
+        ///     Evicts buckets that have refilled completely. Runs on one thread at a time and at most once per refill
+        ///     period, so a limiter full of throttled keys doesn't scan itself on every attempt.
+        /// </summary>
+        private void Sweep()
+        {
+            long nowMsec = clock.ElapsedMilliseconds;
+            if (nowMsec < Volatile.Read(ref nextSweepMsec)) return;
+            if (Interlocked.CompareExchange(ref sweeping, 1, 0) != 0) return;
+
+            foreach (var pair in buckets)
+            {
+                ref long state = ref pair.Value.State;
+                long current = Volatile.Read(ref state);
+
+                // Read after the state, so it is never older than the last refill.
+                if (current == Evicted || Refill(current, Now()) < capacity) continue;
+
+                // Marked first, so an attempt racing with the removal retries on a new bucket instead of losing its token.
+                if (Interlocked.CompareExchange(ref state, Evicted, current) != current) continue;
+
+                if (buckets.TryRemove(pair.Key, out _))
+                {
+                    _ = Interlocked.Decrement(ref count);
+                }
+            }
+
+            Volatile.Write(ref nextSweepMsec, nowMsec + capacity / refillPerSecond);
+            Volatile.Write(ref sweeping, 0);
+        }
+
+        private long Refill(long state, uint now)
+        {
+            int tokens = (int)(state >> 32);
+            uint last = (uint)state;
+
+            // Unsigned subtraction keeps working when the millisecond counter wraps around.
+            long elapsed = (uint)(now - last);
+            long refilled = tokens + elapsed * refillPerSecond;
+
+            return refilled > capacity ? capacity : refilled;
+        }
+
+        private static long Pack(int tokens, uint timestamp)
+        {
+            return ((long)tokens << 32) | timestamp;
+        }
+
+        private static uint Now()
+        {
+            return (uint)clock.ElapsedMilliseconds;
+        }
+    }
+}
@@ -0,0 +1,115 @@
+using System;
+using System.Collections.Generic;
+using System.Text;
+using System.Threading;
+
+namespace AuthenticationServer
+{
+    /// <summary>
+    ///     Records spans of sampled login requests. Every thread writes into its own fixed size ring,
+    ///     so recording never takes a lock or allocates. Rings are dumped in Chrome trace event format
+    ///     (open with chrome://tracing or Perfetto).
+    /// </summary>
+    public static class LoginTracer
+    {
+        private struct Span
+        {
+            public string Name;
+            public long TraceId;
+            public ulong StartUsec;
+            public ulong DurationUsec;
+        }
+
+        private sealed class Ring
+        {
+            public readonly Span[] Spans = new Span[RingCapacity];
+            public readonly int ThreadId = Thread.CurrentThread.ManagedThreadId;
+            public long Head;
+        }
+
+        private const int RingCapacity = 4096;
+
+        // Native MySQL workers use thread ids 1..pool size.
+        private const int ThreadIdOffset = 1000;
+
+        [ThreadStatic]
+        private static Ring ring;
+
+        private static readonly List<Ring> rings = new List<Ring>();
+
+        /// <summary>
+        ///     Every n-th login is traced, 0 disables tracing.
+        /// </summary>
+        public static int Sampling { get; set; }
+
+        public static bool IsSampled(long traceId)
+        {
+            return Sampling > 0 && traceId % Sampling == 0;
+        }
+
+        public static void Record(string name, long traceId, ulong startUsec, ulong endUsec)
+        {
+            if (!IsSampled(traceId)) return;
+
+            if (ring == null)
+            {
+                ring = new Ring();
+                lock (rings)
+                {
+                    rings.Add(ring);
+                }
+            }
+
+            long head = ring.Head;
+            ring.Spans[head & (RingCapacity - 1)] = new Span
+            {
+                Name = name,
+                TraceId = traceId,
+                StartUsec = startUsec,
+                DurationUsec = endUsec - startUsec
+            };
+            Volatile.Write(ref ring.Head, head + 1);
+        }
+
+        /// <summary>
+        ///     Writes recorded spans as Chrome trace JSON.
+        /// </summary>
+        /// <param name="extraEvents">JSON array of events recorded elsewhere (e.g. by the native MySQL library), merged into the output</param>
+        public static string ToChromeTrace(string extraEvents)
+        {
+            var json = new StringBuilder("{\"traceEvents\":[");
+            bool first = true;
+
+            lock (rings)
+            {
+                foreach (Ring threadRing in rings)
+                {
+                    long end = Volatile.Read(ref threadRing.Head);
+                    for (long i = Math.Max(0, end - RingCapacity); i < end; i++)
+                    {
+                        Span span = threadRing.Spans[i & (RingCapacity - 1)];
+
+                        if (!first) json.Append(',');
+                        first = false;
+
+                        json.Append("{\"name\":\"").Append(span.Name)
+                            .Append("\",\"cat\":\"login\",\"ph\":\"X\",\"pid\":1,\"tid\":").Append(ThreadIdOffset + threadRing.ThreadId)
+                            .Append(",\"ts\":").Append(span.StartUsec)
+                            .Append(",\"dur\":").Append(span.DurationUsec)
+                            .Append(",\"args\":{\"id\":").Append(span.TraceId).Append("}}");
+                    }
+                }
+            }
+
+            // Strip brackets of the extra array and append its events.
+            string events = extraEvents?.Trim() ?? "";
+            if (events.Length > 2)
+            {
+                if (!first) json.Append(',');
+                json.Append(events, 1, events.Length - 2);
+            }
+
+            return json.Append("]}").ToString();
+        }
+    }
+}
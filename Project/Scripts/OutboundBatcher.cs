@@ -0,0 +1,107 @@
+using System;
+
+using Batches = System.Collections.Generic.Dictionary<int, AuthenticationServer.OutboundBatcher.Batch>;
+
+namespace AuthenticationServer
+{
+    /// <summary>
+    ///     Coalesces <see cref="AuthPacketCodec"/> frames addressed to the same peer into one packet.
+    ///     A batch is sent when adding a frame would make it bigger than the size limit, or by <see cref="Flush"/>
+    ///     once its oldest frame has waited for the maximum delay.
+    /// </summary>
+    public sealed class OutboundBatcher
+    {
+        internal sealed class Batch
+        {
+            public byte[] Buffer;
+            public int Size;
+            public ulong FirstFrameMsec;
+        }
+
+        private readonly Batches batches = new Batches();
+        private readonly PacketBufferPool packets;
+        private readonly Action<int, byte[]> send;
+        private readonly int maxBytes;
+        private readonly ulong maxDelayMsec;
+
+        /// <param name="send">Sends a finished batch to the peer, the array is reused once it returns</param>
+        /// <param name="maxBytes">Maximum size of a batch, a single bigger frame is sent alone</param>
+        /// <param name="maxDelayMsec">How long a frame can wait for other frames, 0 sends batches on every <see cref="Flush"/></param>
+        public OutboundBatcher(Action<int, byte[]> send, int maxBytes, ulong maxDelayMsec)
+        {
+            this.send = send;
+            this.maxBytes = maxBytes;
+            packets = new PacketBufferPool(maxBytes);
+            this.maxDelayMsec = maxDelayMsec;
+        }
+
+        /// <summary>
+        ///     Reserves <paramref name="size"/> bytes for a frame sent to <paramref name="peerId"/>.
+        ///     The frame must be written into <paramref name="buffer"/> at the returned offset before the next call.
+        /// </summary>
+        public int Reserve(int peerId, int size, ulong nowMsec, out byte[] buffer)
+        {
+            if (!batches.TryGetValue(peerId, out Batch batch))
+            {
+                batch = new Batch { Buffer = new byte[Math.Max(maxBytes, size)] };
+                batches.Add(peerId, batch);
+            }
+
+            if (batch.Size + size > batch.Buffer.Length)
+            {
+                // An empty batch only needs a bigger buffer, sending it would put an empty packet on the wire.
+                if (batch.Size > 0)
+                {
+                    Send(peerId, batch);
+                }
+
+                if (size > batch.Buffer.Length)
+                {
+                    batch.Buffer = new byte[size];
+                }
+            }
+
+            if (batch.Size == 0)
+            {
+                batch.FirstFrameMsec = nowMsec;
+            }
+
+            int offset = batch.Size;
+            batch.Size += size;
+
+            buffer = batch.Buffer;
+            return offset;
+        }
+
+        /// <summary>
+        ///     Sends every batch whose oldest frame has waited at least the maximum delay.
+        /// </summary>
+        public void Flush(ulong nowMsec)
+        {
+            foreach (var pair in batches)
+            {
+                Batch batch = pair.Value;
+                if (batch.Size != 0 && nowMsec - batch.FirstFrameMsec >= maxDelayMsec)
+                {
+                    Send(pair.Key, batch);
+                }
+            }
+        }
+
+        /// <summary>
+        ///     Drops the batch of a disconnected peer.
+        /// </summary>
+        public void Remove(int peerId)
+        {
+            _ = batches.Remove(peerId);
+        }
+
+        private void Send(int peerId, Batch batch)
+        {
+            byte[] packet = packets.Copy(batch.Buffer, batch.Size);
+            batch.Size = 0;
+
+            send(peerId, packet);
+        }
+    }
+}
@@ -0,0 +1,41 @@
+using System;
+using System.Collections.Generic;
+
+namespace AuthenticationServer
+{
+    /// <summary>
+    ///     Byte arrays of an exact length for packets handed to Godot, which sends a byte[] argument whole.
+    ///     Godot copies the array into a PoolByteArray while the packet is sent, so after the send returns the same
+    ///     array can be filled with the next packet of that length, and steady traffic doesn't allocate.
+    /// </summary>
+    public sealed class PacketBufferPool
+    {
+        private readonly Dictionary<int, byte[]> buffers = new Dictionary<int, byte[]>();
+        private readonly int maxLength;
+
+        /// <param name="maxLength">Longest packet whose array is kept, longer ones get a new array every time</param>
+        public PacketBufferPool(int maxLength)
+        {
+            this.maxLength = maxLength;
+        }
+
+        /// <summary>
+        ///     Copies the first <paramref name="length"/> bytes of <paramref name="source"/> into the array kept for that length.
+        ///     The returned array must not be used after the packet was sent.
+        /// </summary>
+        public byte[] Copy(byte[] source, int length)
+        {
+            if (length > maxLength || !buffers.TryGetValue(length, out byte[] packet))
+            {
+                packet = new byte[length];
+                if (length <= maxLength)
+                {
+                    buffers.Add(length, packet);
+                }
+            }
+
+            Buffer.BlockCopy(source, 0, packet, 0, length);
+            return packet;
+        }
+    }
+}
@@ -17,18 +17,13 @@ namespace AuthenticationServer
 
         private readonly Gateways gateways;
         private readonly GameWorlds gameWorlds;
-
-        public int OptimalGameWorldId 
-        {
-            get => optimalGameWorldId;
-        }
-
-        private int optimalGameWorldId = -1;
+        private readonly GameWorldScheduler gameWorldScheduler;
 
         private SubServersContainer()
         {
             gateways = new Gateways();
             gameWorlds = new GameWorlds();
+            gameWorldScheduler = new GameWorldScheduler();
         }
 
         public void AddGateway(int peerId)
@@ -38,10 +33,10 @@ namespace AuthenticationServer
 
         public void AddGameWorld(int peerId)
         {
-            // Newly added GameWorld is always the most optimal
-            optimalGameWorldId = peerId;
+            var gameWorld = new GameWorld(peerId);
 
-            gameWorlds.Add(peerId, new GameWorld());
+            gameWorlds.Add(peerId, gameWorld);
+            gameWorldScheduler.Add(gameWorld);
         }
 
         public bool GatewayExists(int peerId)
@@ -51,7 +46,7 @@ namespace AuthenticationServer
 
         public bool GameWorldExists(int peerId)
         {
-            return gateways.ContainsKey(peerId);
+            return gameWorlds.ContainsKey(peerId);
         }
 
         public bool RemoveGateway(int peerId)
@@ -61,15 +56,34 @@ namespace AuthenticationServer
 
         public bool RemoveGameWorld(int peerId)
         {
+            if (!gameWorlds.TryGetValue(peerId, out GameWorld gameWorld)) return false;
+
+            gameWorldScheduler.Remove(gameWorld);
             return gameWorlds.Remove(peerId);
         }
 
-        // TODO: :)
-        public void IncrementGameWorldPlayerCount()
+        /// <summary>
+        ///     Picks the least loaded Game World Server and reserves a player slot on it.
+        ///     The slot stays reserved until <see cref="CancelPlacement"/> is called.
+        /// </summary>
+        /// <returns>Id of the Game World Server or -1 if there is no Game World Server</returns>
+        public int ReservePlacement()
         {
+            GameWorld gameWorld = gameWorldScheduler.Reserve();
+            return gameWorld?.PeerId ?? -1;
+        }
 
+        /// <summary>
+        ///     Releases a reservation once its token expired.
+        /// </summary>
+        public void CancelPlacement(int peerId)
+        {
+            if (!gameWorlds.TryGetValue(peerId, out GameWorld gameWorld) || gameWorld.ReservedCount == 0) return;
+
+            gameWorld.ReservedCount--;
+            gameWorldScheduler.Update(gameWorld);
         }
-        
+
         public bool Remove(int peerId)
         {
             return RemoveGateway(peerId) || RemoveGameWorld(peerId);
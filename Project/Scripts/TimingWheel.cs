@@ -0,0 +1,215 @@
+using System;
+
+using Entries = System.Collections.Generic.Dictionary<long, int>;
+
+namespace AuthenticationServer
+{
+    /// <summary>
+    ///     Hierarchical timing wheel (4 levels of 64 slots). Timers are identified by a <see cref="long"/> key,
+    ///     arming and cancelling are O(1) and all expirations are driven by <see cref="Advance"/>.
+    ///     Timer entries are kept in preallocated arrays and reused, so arming does not allocate once the wheel has warmed up.
+    /// </summary>
+    public sealed class TimingWheel
+    {
+        private const int SlotBits = 6;
+        private const int SlotCount = 1 << SlotBits;
+        private const int SlotMask = SlotCount - 1;
+        private const int LevelCount = 4;
+        private const long MaxDelay = (1L << (SlotBits * LevelCount)) - 1;
+
+        private readonly Action<long> onExpired;
+        private readonly ulong tickMsec;
+
+        private readonly int[] heads = new int[SlotCount * LevelCount];
+        private readonly Entries entries = new Entries();
+
+        // Entry storage, entry `i` is described by the i-th element of every array.
+        private long[] keys;
+        private long[] expirations;
+        private int[] slots;
+        private int[] next;
+        private int[] previous;
+        private int freeHead;
+
+        private long currentTick;
+
+        public int Count => entries.Count;
+
+        /// <param name="tickMsec">Resolution of the wheel in milliseconds</param>
+        /// <param name="onExpired">Called with the key of every timer that expired during <see cref="Advance"/></param>
+        public TimingWheel(ulong tickMsec, ulong nowMsec, Action<long> onExpired, int initialCapacity = 64)
+        {
+            this.tickMsec = tickMsec;
+            this.onExpired = onExpired;
+            currentTick = (long)(nowMsec / tickMsec);
+
+            for (int i = 0; i < heads.Length; i++)
+            {
+                heads[i] = -1;
+            }
+
+            keys = new long[0];
+            expirations = new long[0];
+            slots = new int[0];
+            next = new int[0];
+            previous = new int[0];
+            freeHead = -1;
+            Grow(initialCapacity);
+        }
+
+        /// <summary>
+        ///     Arms timer <paramref name="key"/> to expire after <paramref name="delayMsec"/>. Rearms it if it is already armed.
+        /// </summary>
+        public void Arm(long key, ulong delayMsec)
+        {
+            _ = Cancel(key);
+
+            long delay = Math.Max(1, Math.Min(MaxDelay, (long)((delayMsec + tickMsec - 1) / tickMsec)));
+
+            int entry = Allocate();
+            keys[entry] = key;
+            expirations[entry] = currentTick + delay;
+            entries.Add(key, entry);
+
+            Insert(entry);
+        }
+
+        /// <returns><c>true</c> if timer <paramref name="key"/> was armed</returns>
+        public bool Cancel(long key)
+        {
+            if (!entries.TryGetValue(key, out int entry)) return false;
+
+            _ = entries.Remove(key);
+            Unlink(entry);
+            Free(entry);
+            return true;
+        }
+
+        public bool IsArmed(long key)
+        {
+            return entries.ContainsKey(key);
+        }
+
+        /// <summary>
+        ///     Moves the wheel to <paramref name="nowMsec"/> and fires every timer that expired on the way.
+        /// </summary>
+        public void Advance(ulong nowMsec)
+        {
+            long targetTick = (long)(nowMsec / tickMsec);
+
+            while (currentTick < targetTick)
+            {
+                currentTick++;
+
+                // Move timers of the next higher level slot down, level by level, when a lower level wraps around.
+                for (int level = 1; level < LevelCount; level++)
+                {
+                    if (((currentTick >> (SlotBits * (level - 1))) & SlotMask) != 0) break;
+
+                    Cascade(level * SlotCount + (int)((currentTick >> (SlotBits * level)) & SlotMask));
+                }
+
+                int slot = (int)(currentTick & SlotMask);
+                while (heads[slot] != -1)
+                {
+                    int entry = heads[slot];
+                    long key = keys[entry];
+
+                    _ = entries.Remove(key);
+                    Unlink(entry);
+                    Free(entry);
+
+                    onExpired(key);
+                }
+            }
+        }
+
+        private void Cascade(int slot)
+        {
+            int entry = heads[slot];
+            heads[slot] = -1;
+
+            while (entry != -1)
+            {
+                int following = next[entry];
+                Insert(entry);
+                entry = following;
+            }
+        }
+
+        private void Insert(int entry)
+        {
+            long delta = expirations[entry] - currentTick;
+
+            int level = 0;
+            while (level < LevelCount - 1 && delta >= 1L << (SlotBits * (level + 1)))
+            {
+                level++;
+            }
+
+            int slot = level * SlotCount + (int)((expirations[entry] >> (SlotBits * level)) & SlotMask);
+
+            slots[entry] = slot;
+            previous[entry] = -1;
+            next[entry] = heads[slot];
+            if (heads[slot] != -1)
+            {
+                previous[heads[slot]] = entry;
+            }
+            heads[slot] = entry;
+        }
+
+        private void Unlink(int entry)
+        {
+            if (previous[entry] != -1)
+            {
+                next[previous[entry]] = next[entry];
+            }
+            else
+            {
+                heads[slots[entry]] = next[entry];
+            }
+
+            if (next[entry] != -1)
+            {
+                previous[next[entry]] = previous[entry];
+            }
+        }
+
+        private int Allocate()
+        {
+            if (freeHead == -1)
+            {
+                Grow(keys.Length * 2);
+            }
+
+            int entry = freeHead;
+            freeHead = next[entry];
+            return entry;
+        }
+
+        private void Free(int entry)
+        {
+            next[entry] = freeHead;
+            freeHead = entry;
+        }
+
+        private void Grow(int capacity)
+        {
+            int oldCapacity = keys.Length;
+            capacity = Math.Max(capacity, 1);
+
+            Array.Resize(ref keys, capacity);
+            Array.Resize(ref expirations, capacity);
+            Array.Resize(ref slots, capacity);
+            Array.Resize(ref next, capacity);
+            Array.Resize(ref previous, capacity);
+
+            for (int i = capacity - 1; i >= oldCapacity; i--)
+            {
+                next[i] = freeHead;
+                freeHead = i;
+            }
+        }
+    }
+}
@@ -0,0 +1,68 @@
+using System.Collections.Generic;
+
+using Godot;
+
+namespace NightFallBenchmarks
+{
+    /// <summary>
+    ///     Runs microbenchmarks of the Authentication Server's hot paths and prints one table per benchmark.
+    ///     Run headless, arguments are passed after `--`:
+    ///     <code>
+    ///         godot --no-window -- --run=rate-limiter,codec --threads=8 --seconds=3
+    ///     </code>
+    /// </summary>
+    public class Benchmarks : Node
+    {
+        private readonly Dictionary<string, string> arguments = new Dictionary<string, string>();
+
+        public override void _Ready()
+        {
+            ParseArguments();
+
+            string run = GetArgument("run", "rate-limiter,codec");
+            int threads = GetArgument("threads", System.Environment.ProcessorCount);
+            int seconds = GetArgument("seconds", 3);
+
+            foreach (string benchmark in run.Split(','))
+            {
+                switch (benchmark)
+                {
+                    case "rate-limiter":
+                        RateLimiterBenchmark.Run(threads, seconds);
+                        break;
+                    case "codec":
+                        CodecBenchmark.Run(seconds);
+                        break;
+                    default:
+                        GD.PrintErr($"Unknown benchmark {benchmark}.");
+                        break;
+                }
+            }
+
+            GetTree().Quit(0);
+        }
+
+        private void ParseArguments()
+        {
+            foreach (string argument in OS.GetCmdlineArgs())
+            {
+                if (!argument.StartsWith("--")) continue;
+
+                int separator = argument.IndexOf('=');
+                if (separator == -1) continue;
+
+                arguments[argument.Substring(2, separator - 2)] = argument.Substring(separator + 1);
+            }
+        }
+
+        private string GetArgument(string name, string @default)
+        {
+            return arguments.TryGetValue(name, out string value) ? value : @default;
+        }
+
+        private int GetArgument(string name, int @default)
+        {
+            return arguments.TryGetValue(name, out string value) && int.TryParse(value, out int result) ? result : @default;
+        }
+    }
+}
@@ -0,0 +1,102 @@
+using System.Diagnostics;
+
+using Godot;
+
+using AuthenticationServer;
+
+namespace NightFallBenchmarks
+{
+    /// <summary>
+    ///     Cost of an auth response sent with <see cref="AuthPacketCodec"/> against the Variant path it replaced, where
+    ///     fields were sent as RPC arguments. Both go through Godot's Variant encoding the way an RPC does, so the
+    ///     numbers include what the engine adds on top of the codec.
+    /// </summary>
+    public static class CodecBenchmark
+    {
+        private const int PacketType = 1;
+        private const int FramesPerBatch = 16;
+
+        private delegate int Round();
+
+        public static void Run(int seconds)
+        {
+            string ipAddress = "192.168.100.200";
+            string token = new string('x', AuthPacketCodec.TokenLength);
+
+            var frames = new byte[AuthPacketCodec.AuthResponseSize(ipAddress, token) * FramesPerBatch];
+            var packets = new PacketBufferPool(frames.Length);
+            int clientId = 0;
+
+            GD.Print("auth response |       frames/s | ns/frame | bytes/frame");
+
+            // Old path: client id, ip and token as RPC arguments, one packet per response.
+            Measure("variant", seconds, () =>
+            {
+                byte[] bytes = GD.Var2Bytes(new Godot.Collections.Array { PacketType, new Godot.Collections.Array { clientId++, ipAddress, token } });
+
+                var packet = (Godot.Collections.Array)GD.Bytes2Var(bytes);
+                var args = (Godot.Collections.Array)packet[1];
+                if (!(args[0] is int) || !(args[1] is string) || !(args[2] is string)) throw new System.InvalidOperationException();
+
+                return bytes.Length;
+            }, 1);
+
+            Measure("codec", seconds, () => SendFrames(frames, packets, 1, ref clientId, ipAddress, token), 1);
+            Measure("codec batched", seconds, () => SendFrames(frames, packets, FramesPerBatch, ref clientId, ipAddress, token), FramesPerBatch);
+        }
+
+        private static int SendFrames(byte[] frames, PacketBufferPool packets, int count, ref int clientId, string ipAddress, string token)
+        {
+            int size = 0;
+            for (int i = 0; i < count; i++)
+            {
+                size += AuthPacketCodec.WriteAuthResponse(frames, size, clientId++, AuthPacketCodec.AuthStatus.Success, ipAddress, token);
+            }
+
+            byte[] bytes = GD.Var2Bytes(new Godot.Collections.Array { PacketType, new Godot.Collections.Array { packets.Copy(frames, size) } });
+
+            var packet = (Godot.Collections.Array)GD.Bytes2Var(bytes);
+            var args = (Godot.Collections.Array)packet[1];
+            var buffer = (byte[])args[0];
+
+            int offset = 0;
+            while (AuthPacketCodec.TryReadHeader(buffer, offset, out AuthPacketCodec.FrameKind _, out int bodyLength))
+            {
+                int bodyOffset = offset + AuthPacketCodec.HeaderSize;
+                offset = bodyOffset + bodyLength;
+
+                if (!AuthPacketCodec.TryReadAuthResponse(buffer, bodyOffset, bodyLength, out int _, out AuthPacketCodec.AuthStatus _, out string _, out string _)) throw new System.InvalidOperationException();
+            }
+
+            return bytes.Length;
+        }
+
+        private static void Measure(string name, int seconds, Round round, int framesPerRound)
+        {
+            // Warm up, so JIT and first allocations aren't measured.
+            for (int i = 0; i < 1000; i++)
+            {
+                _ = round();
+            }
+
+            long rounds = 0;
+            long bytes = 0;
+            long stopAfterMsec = seconds * 1000L;
+
+            var stopwatch = Stopwatch.StartNew();
+            while (stopwatch.ElapsedMilliseconds < stopAfterMsec)
+            {
+                for (int i = 0; i < 64; i++, rounds++)
+                {
+                    bytes += round();
+                }
+            }
+            stopwatch.Stop();
+
+            long frames = rounds * framesPerRound;
+            double perSecond = frames / stopwatch.Elapsed.TotalSeconds;
+            double nsPerFrame = stopwatch.Elapsed.TotalMilliseconds * 1000000.0 / frames;
+            GD.Print($"{name,13} | {perSecond,14:N0} | {nsPerFrame,8:F1} | {(double)bytes / frames,11:F1}");
+        }
+    }
+}
@@ -0,0 +1,128 @@
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Threading;
+
+using Godot;
+
+using AuthenticationServer;
+
+namespace NightFallBenchmarks
+{
+    /// <summary>
+    ///     Checks per second of <see cref="LoginRateLimiter"/> from 1 up to the given number of threads, for keys
+    ///     every thread shares, keys every thread owns and a spray of keys never seen before (which fills the limiter
+    ///     and makes it evict).
+    /// </summary>
+    public static class RateLimiterBenchmark
+    {
+        private const int KeysPerThread = 4096;
+        private const int MaxKeys = 262144;
+
+        private delegate string KeyOf(int thread, long attempt);
+
+        public static void Run(int maxThreads, int seconds)
+        {
+            // A million attempts a second keep spread keys allowed, a single key is drained and measures the rejected path.
+            var shared = new LoginRateLimiter(MaxKeys, 1000, 1000000);
+            string[] sharedKeys = CreateKeys("shared", KeysPerThread);
+
+            string[][] ownKeys = new string[maxThreads][];
+            for (int i = 0; i < maxThreads; i++)
+            {
+                ownKeys[i] = CreateKeys($"thread{i}_", KeysPerThread);
+            }
+
+            GD.Print("rate limiter | threads |    checks/s | ns/check | allowed % | keys");
+            foreach (int threads in ThreadCounts(maxThreads))
+            {
+                Measure("same key", threads, seconds, shared, (thread, attempt) => sharedKeys[0]);
+                Measure("shared keys", threads, seconds, shared, (thread, attempt) => sharedKeys[attempt & (KeysPerThread - 1)]);
+                Measure("own keys", threads, seconds, shared, (thread, attempt) => ownKeys[thread][attempt & (KeysPerThread - 1)]);
+
+                // Keys are built outside the timed part of the other cases, this one includes formatting them.
+                var spray = new LoginRateLimiter(MaxKeys, 5, 1);
+                Measure("key spray", threads, seconds, spray, (thread, attempt) => $"spray{thread}_{attempt}");
+            }
+        }
+
+        /// <returns>Powers of two below <paramref name="maxThreads"/>, then <paramref name="maxThreads"/> itself</returns>
+        private static List<int> ThreadCounts(int maxThreads)
+        {
+            var counts = new List<int>();
+            for (int threads = 1; threads < maxThreads; threads *= 2)
+            {
+                counts.Add(threads);
+            }
+            counts.Add(maxThreads);
+
+            return counts;
+        }
+
+        private static void Measure(string name, int threads, int seconds, LoginRateLimiter limiter, KeyOf keyOf)
+        {
+            long[] attempts = new long[threads];
+            long[] allowed = new long[threads];
+            bool stop = false;
+
+            var workers = new Thread[threads];
+            var start = new Barrier(threads + 1);
+            for (int i = 0; i < threads; i++)
+            {
+                int thread = i;
+                workers[i] = new Thread(() =>
+                {
+                    long attempt = 0;
+                    long passed = 0;
+
+                    start.SignalAndWait();
+                    while (!Volatile.Read(ref stop))
+                    {
+                        // Checked in batches, so reading the stop flag doesn't show up in the result.
+                        for (int j = 0; j < 256; j++, attempt++)
+                        {
+                            if (limiter.TryAcquire(keyOf(thread, attempt))) passed++;
+                        }
+                    }
+
+                    attempts[thread] = attempt;
+                    allowed[thread] = passed;
+                });
+                workers[i].Start();
+            }
+
+            start.SignalAndWait();
+            var stopwatch = Stopwatch.StartNew();
+            Thread.Sleep(seconds * 1000);
+            Volatile.Write(ref stop, true);
+
+            foreach (Thread worker in workers)
+            {
+                worker.Join();
+            }
+            stopwatch.Stop();
+
+            long totalAttempts = 0;
+            long totalAllowed = 0;
+            for (int i = 0; i < threads; i++)
+            {
+                totalAttempts += attempts[i];
+                totalAllowed += allowed[i];
+            }
+
+            double perSecond = totalAttempts / stopwatch.Elapsed.TotalSeconds;
+            double nsPerCheck = stopwatch.Elapsed.TotalMilliseconds * 1000000.0 * threads / totalAttempts;
+            GD.Print($"{name,12} | {threads,7} | {perSecond,11:N0} | {nsPerCheck,8:F1} | {100.0 * totalAllowed / totalAttempts,9:F1} | {limiter.Count}");
+        }
+
+        private static string[] CreateKeys(string prefix, int count)
+        {
+            var keys = new string[count];
+            for (int i = 0; i < count; i++)
+            {
+                keys[i] = prefix + i;
+            }
+
+            return keys;
+        }
+    }
+}
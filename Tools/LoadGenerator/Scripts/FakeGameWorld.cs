@@ -0,0 +1,46 @@
+using Godot;
+
+using SharedUtils.Networking;
+
+using AuthenticationServer;
+
+namespace NightFallLoadGenerator
+{
+    /// <summary>
+    ///     Authenticates as a Game World Server and counts the tokens it receives.
+    /// </summary>
+    public sealed class FakeGameWorld : FakePeer
+    {
+        private readonly string authToken;
+
+        public int TokensReceived { get; private set; }
+
+        public FakeGameWorld(string authToken)
+        {
+            this.authToken = authToken;
+        }
+
+        protected override void OnConnected()
+        {
+            Send(PacketType.GameWorldServerAuth, authToken);
+        }
+
+        protected override void OnPacketReceived(PacketType packetType, object[] args)
+        {
+            if (packetType != PacketType.AuthenticationServerSendToken) return;
+            if (args.Length != 1 || !(args[0] is byte[] packet)) return;
+
+            int offset = 0;
+            while (AuthPacketCodec.TryReadHeader(packet, offset, out AuthPacketCodec.FrameKind kind, out int bodyLength))
+            {
+                int bodyOffset = offset + AuthPacketCodec.HeaderSize;
+                offset = bodyOffset + bodyLength;
+
+                if (kind != AuthPacketCodec.FrameKind.SendToken) continue;
+                if (!AuthPacketCodec.TryReadSendToken(packet, bodyOffset, bodyLength, out string token)) continue;
+
+                TokensReceived++;
+            }
+        }
+    }
+}
@@ -0,0 +1,74 @@
+using Godot;
+
+using SharedUtils.Networking;
+
+using AuthenticationServer;
+
+namespace NightFallLoadGenerator
+{
+    /// <summary>
+    ///     Authenticates as a Gateway Server and forwards synthetic logins.
+    ///     Logins queued during a frame are sent together, like a real Gateway Server under load would.
+    /// </summary>
+    public sealed class FakeGateway : FakePeer
+    {
+        public delegate void ResponseHandler(FakeGateway gateway, int clientId, AuthPacketCodec.AuthStatus status);
+
+        private readonly string authToken;
+        private readonly ResponseHandler onResponse;
+        private readonly PacketBufferPool packets = new PacketBufferPool(4096);
+
+        private byte[] buffer = new byte[4096];
+        private int size;
+
+        public FakeGateway(string authToken, ResponseHandler onResponse)
+        {
+            this.authToken = authToken;
+            this.onResponse = onResponse;
+        }
+
+        public void QueueLogin(int clientId, string login, string password, string ipAddress)
+        {
+            int frameSize = AuthPacketCodec.AuthForwardSize(login, password, ipAddress);
+            if (size + frameSize > buffer.Length)
+            {
+                System.Array.Resize(ref buffer, buffer.Length * 2);
+            }
+
+            size += AuthPacketCodec.WriteAuthForward(buffer, size, clientId, login, password, ipAddress);
+        }
+
+        public void Flush()
+        {
+            if (size == 0 || !IsConnectedToServer) return;
+
+            byte[] packet = packets.Copy(buffer, size);
+            size = 0;
+
+            Send(PacketType.GatewayServerAuthForward, packet);
+        }
+
+        protected override void OnConnected()
+        {
+            Send(PacketType.GatewayServerAuth, authToken);
+        }
+
+        protected override void OnPacketReceived(PacketType packetType, object[] args)
+        {
+            if (packetType != PacketType.AuthenticationServerAuthResponse) return;
+            if (args.Length != 1 || !(args[0] is byte[] packet)) return;
+
+            int offset = 0;
+            while (AuthPacketCodec.TryReadHeader(packet, offset, out AuthPacketCodec.FrameKind kind, out int bodyLength))
+            {
+                int bodyOffset = offset + AuthPacketCodec.HeaderSize;
+                offset = bodyOffset + bodyLength;
+
+                if (kind != AuthPacketCodec.FrameKind.AuthResponse) continue;
+                if (!AuthPacketCodec.TryReadAuthResponse(packet, bodyOffset, bodyLength, out int clientId, out AuthPacketCodec.AuthStatus status, out string _, out string _)) continue;
+
+                onResponse(this, clientId, status);
+            }
+        }
+    }
+}
@@ -0,0 +1,87 @@
+using Godot;
+
+using SharedUtils.Networking;
+
+namespace NightFallLoadGenerator
+{
+    /// <summary>
+    ///     Connection to the Authentication Server that pretends to be a sub server.
+    ///     Every fake peer has its own <see cref="MultiplayerAPI"/>, so one process can hold many connections.
+    /// </summary>
+    public abstract class FakePeer : Node
+    {
+        /// <summary>
+        ///     Node that mirrors the path of the server's InternalNetwork, RPCs are sent from and received on it.
+        /// </summary>
+        private sealed class PacketEndpoint : Node
+        {
+            public FakePeer Peer;
+
+            // Name and signature must match the remote method NetworkedServer (SharedUtils) exchanges packets with.
+            [Remote]
+            public void PacketReceived(int packetType, Godot.Collections.Array args)
+            {
+                var values = new object[args.Count];
+                args.CopyTo(values, 0);
+
+                Peer.OnPacketReceived((PacketType)packetType, values);
+            }
+        }
+
+        private readonly NetworkedMultiplayerENet peer = new NetworkedMultiplayerENet();
+        private readonly MultiplayerAPI multiplayer = new MultiplayerAPI();
+        private PacketEndpoint endpoint;
+
+        public bool IsConnectedToServer { get; private set; }
+
+        public Error ConnectToServer(string host, int port)
+        {
+            endpoint = new PacketEndpoint { Name = "InternalNetwork", Peer = this };
+            AddChild(endpoint);
+
+            peer.UseDtls = true;
+            peer.DtlsVerify = false;
+
+            Error error = peer.CreateClient(host, port);
+            if (error != Error.Ok) return error;
+
+            multiplayer.RootNode = this;
+            multiplayer.NetworkPeer = peer;
+            endpoint.CustomMultiplayer = multiplayer;
+
+            _ = multiplayer.Connect("connected_to_server", this, nameof(ConnectedToServer));
+            _ = multiplayer.Connect("server_disconnected", this, nameof(ServerDisconnected));
+
+            return Error.Ok;
+        }
+
+        public override void _Process(float delta)
+        {
+            if (multiplayer.NetworkPeer != null)
+            {
+                multiplayer.Poll();
+            }
+        }
+
+        protected void Send(PacketType packetType, params object[] args)
+        {
+            endpoint.RpcId(1, nameof(PacketEndpoint.PacketReceived), (int)packetType, new Godot.Collections.Array(args));
+        }
+
+        protected abstract void OnConnected();
+
+        protected abstract void OnPacketReceived(PacketType packetType, object[] args);
+
+        private void ConnectedToServer()
+        {
+            IsConnectedToServer = true;
+            OnConnected();
+        }
+
+        private void ServerDisconnected()
+        {
+            IsConnectedToServer = false;
+            GD.PrintErr($"{Name} lost connection to the Authentication Server.");
+        }
+    }
+}
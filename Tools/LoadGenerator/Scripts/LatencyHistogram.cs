@@ -0,0 +1,70 @@
+using System;
+
+namespace NightFallLoadGenerator
+{
+    /// <summary>
+    ///     Log-linear histogram of latencies in microseconds, 32 sub-buckets per power of two (~3% precision).
+    /// </summary>
+    public sealed class LatencyHistogram
+    {
+        private const int SubBucketBits = 5;
+        private const int SubBucketCount = 1 << SubBucketBits;
+
+        private readonly long[] counts = new long[64 * SubBucketCount];
+
+        public long Count { get; private set; }
+
+        public void Record(ulong usec)
+        {
+            counts[IndexOf(usec)]++;
+            Count++;
+        }
+
+        public void Clear()
+        {
+            Array.Clear(counts, 0, counts.Length);
+            Count = 0;
+        }
+
+        /// <param name="percentile">Between 0 and 1</param>
+        /// <returns>Latency in microseconds (lower bound of the bucket)</returns>
+        public ulong Percentile(double percentile)
+        {
+            if (Count == 0) return 0;
+
+            long rank = Math.Max(1, (long)Math.Ceiling(percentile * Count));
+            long seen = 0;
+
+            for (int i = 0; i < counts.Length; i++)
+            {
+                seen += counts[i];
+                if (seen >= rank) return ValueOf(i);
+            }
+
+            return ValueOf(counts.Length - 1);
+        }
+
+        private static int IndexOf(ulong value)
+        {
+            if (value < SubBucketCount) return (int)value;
+
+            int msb = 63;
+            while ((value >> msb) == 0)
+            {
+                msb--;
+            }
+
+            return (msb - SubBucketBits + 1) * SubBucketCount + (int)((value >> (msb - SubBucketBits)) & (SubBucketCount - 1));
+        }
+
+        private static ulong ValueOf(int index)
+        {
+            if (index < SubBucketCount) return (ulong)index;
+
+            int msb = index / SubBucketCount + SubBucketBits - 1;
+            ulong subBucket = (ulong)(index % SubBucketCount);
+
+            return (SubBucketCount + subBucket) << (msb - SubBucketBits);
+        }
+    }
+}
@@ -0,0 +1,289 @@
+using System.Collections.Generic;
+
+using Godot;
+
+using AuthenticationServer;
+
+namespace NightFallLoadGenerator
+{
+    /// <summary>
+    ///     Puts open-loop login load on an Authentication Server through fake Gateway Servers and reports throughput
+    ///     and latency for every offered rate. Run headless, arguments are passed after `--`:
+    ///     <code>
+    ///         godot --no-window -- --host=127.0.0.1 --port=4444 --gateways=4 --game-worlds=3 --rates=500,1000,2000 --step-seconds=10 --users=100000
+    ///     </code>
+    ///     Logins are sent at their scheduled time whether earlier ones were answered or not, and latency is measured
+    ///     from the scheduled time, so a slow server can't hide its queueing delay.
+    /// </summary>
+    public class LoadGenerator : Node
+    {
+        private enum Phase
+        {
+            Connecting,
+            Warmup,
+            Running,
+            Draining,
+            Done,
+        }
+
+        private struct StepResult
+        {
+            public int OfferedRate;
+            public double AchievedRate;
+            public long Succeeded;
+            public long Failed;
+            public long Busy;
+            public long Lost;
+            public ulong P50Usec;
+            public ulong P99Usec;
+            public ulong P999Usec;
+        }
+
+        private const ulong WarmupUsec = 1000000;
+
+        private readonly Dictionary<string, string> arguments = new Dictionary<string, string>();
+
+        private readonly List<FakeGateway> gateways = new List<FakeGateway>();
+        private readonly List<FakeGameWorld> gameWorlds = new List<FakeGameWorld>();
+
+        // Client id of every unanswered login mapped to the time it was scheduled at.
+        private readonly Dictionary<int, ulong> inFlight = new Dictionary<int, ulong>();
+        private readonly LatencyHistogram histogram = new LatencyHistogram();
+        private readonly List<StepResult> results = new List<StepResult>();
+
+        private int[] rates;
+        private ulong stepUsec;
+        private ulong drainUsec;
+        private int userCount;
+
+        private Phase phase = Phase.Connecting;
+        private ulong phaseUntilUsec;
+        private int stepIndex;
+        private ulong stepStartUsec;
+        private ulong lastResponseUsec;
+        private long sent;
+        private long succeeded;
+        private long failed;
+        private long busy;
+        private int nextClientId;
+
+        public override void _Ready()
+        {
+            ParseArguments();
+
+            string host = GetArgument("host", "127.0.0.1");
+            int port = GetArgument("port", 4444);
+            int gatewayCount = GetArgument("gateways", 1);
+            int gameWorldCount = GetArgument("game-worlds", 1);
+
+            rates = System.Array.ConvertAll(GetArgument("rates", "100,500,1000").Split(','), int.Parse);
+            stepUsec = (ulong)GetArgument("step-seconds", 10) * 1000000;
+            drainUsec = (ulong)GetArgument("drain-seconds", 5) * 1000000;
+            userCount = GetArgument("users", 10000);
+
+            for (int i = 0; i < gameWorldCount; i++)
+            {
+                var gameWorld = new FakeGameWorld(OS.GetEnvironment("GAME_SERVER_TOKEN")) { Name = $"GameWorld{i}" };
+                AddChild(gameWorld);
+                gameWorlds.Add(gameWorld);
+                ConnectPeer(gameWorld, host, port);
+            }
+
+            for (int i = 0; i < gatewayCount; i++)
+            {
+                var gateway = new FakeGateway(OS.GetEnvironment("GATEWAY_TOKEN"), OnResponse) { Name = $"Gateway{i}" };
+                AddChild(gateway);
+                gateways.Add(gateway);
+                ConnectPeer(gateway, host, port);
+            }
+
+            GD.Print($"Connecting {gatewayCount} gateways and {gameWorldCount} game worlds to {host}:{port}...");
+        }
+
+        public override void _Process(float delta)
+        {
+            ulong now = OS.GetTicksUsec();
+
+            switch (phase)
+            {
+                case Phase.Connecting:
+                    {
+                        if (gateways.TrueForAll(gateway => gateway.IsConnectedToServer) && gameWorlds.TrueForAll(gameWorld => gameWorld.IsConnectedToServer))
+                        {
+                            // Server doesn't acknowledge sub server authentication, give it a moment instead.
+                            phase = Phase.Warmup;
+                            phaseUntilUsec = now + WarmupUsec;
+                        }
+                        break;
+                    }
+                case Phase.Warmup:
+                    {
+                        if (now >= phaseUntilUsec)
+                        {
+                            StartStep(now);
+                        }
+                        break;
+                    }
+                case Phase.Running:
+                    {
+                        SendDueLogins(now);
+
+                        if (now - stepStartUsec >= stepUsec)
+                        {
+                            phase = Phase.Draining;
+                            phaseUntilUsec = now + drainUsec;
+                        }
+                        break;
+                    }
+                case Phase.Draining:
+                    {
+                        if (inFlight.Count == 0 || now >= phaseUntilUsec)
+                        {
+                            FinishStep();
+                        }
+                        break;
+                    }
+                default:
+                    break;
+            }
+        }
+
+        private void StartStep(ulong now)
+        {
+            phase = Phase.Running;
+            stepStartUsec = now;
+            lastResponseUsec = now;
+            sent = 0;
+            succeeded = 0;
+            failed = 0;
+            busy = 0;
+            histogram.Clear();
+
+            GD.Print($"Offering {rates[stepIndex]} logins/s for {stepUsec / 1000000} s...");
+        }
+
+        private void SendDueLogins(ulong now)
+        {
+            int rate = rates[stepIndex];
+            long due = (long)((now - stepStartUsec) * (ulong)rate / 1000000);
+
+            for (; sent < due; sent++)
+            {
+                ulong scheduledUsec = stepStartUsec + (ulong)sent * 1000000 / (ulong)rate;
+
+                int clientId = nextClientId++;
+                int user = clientId % userCount;
+
+                inFlight[clientId] = scheduledUsec;
+                gateways[(int)(sent % gateways.Count)].QueueLogin(clientId, $"load_user{user}", $"load_password{user}", $"10.{(user >> 16) & 255}.{(user >> 8) & 255}.{user & 255}");
+            }
+
+            foreach (FakeGateway gateway in gateways)
+            {
+                gateway.Flush();
+            }
+        }
+
+        private void OnResponse(FakeGateway gateway, int clientId, AuthPacketCodec.AuthStatus status)
+        {
+            if (!inFlight.TryGetValue(clientId, out ulong scheduledUsec)) return;
+
+            _ = inFlight.Remove(clientId);
+
+            lastResponseUsec = OS.GetTicksUsec();
+
+            // Latency is reported for logins the server admitted, busy and rate limited answers are counted only.
+            if (status == AuthPacketCodec.AuthStatus.ServerBusy || status == AuthPacketCodec.AuthStatus.RateLimited)
+            {
+                busy++;
+                return;
+            }
+
+            histogram.Record(lastResponseUsec - scheduledUsec);
+
+            if (status == AuthPacketCodec.AuthStatus.Success)
+            {
+                succeeded++;
+            }
+            else
+            {
+                failed++;
+            }
+        }
+
+        private void FinishStep()
+        {
+            double seconds = (lastResponseUsec - stepStartUsec) / 1000000.0;
+
+            results.Add(new StepResult
+            {
+                OfferedRate = rates[stepIndex],
+                AchievedRate = seconds > 0 ? succeeded / seconds : 0,
+                Succeeded = succeeded,
+                Failed = failed,
+                Busy = busy,
+                Lost = inFlight.Count,
+                P50Usec = histogram.Percentile(0.5),
+                P99Usec = histogram.Percentile(0.99),
+                P999Usec = histogram.Percentile(0.999)
+            });
+
+            // Answers to logins of this step arriving later must not count towards the next one.
+            inFlight.Clear();
+
+            stepIndex++;
+            if (stepIndex < rates.Length)
+            {
+                StartStep(OS.GetTicksUsec());
+                return;
+            }
+
+            phase = Phase.Done;
+            PrintReport();
+            GetTree().Quit(0);
+        }
+
+        private void PrintReport()
+        {
+            GD.Print("offered/s | logins/s | succeeded | failed | busy | lost | p50 ms | p99 ms | p999 ms");
+            foreach (StepResult result in results)
+            {
+                GD.Print($"{result.OfferedRate,9} | {result.AchievedRate,8:F1} | {result.Succeeded,9} | {result.Failed,6} | {result.Busy,4} | {result.Lost,4} | " +
+                    $"{result.P50Usec / 1000.0,6:F2} | {result.P99Usec / 1000.0,6:F2} | {result.P999Usec / 1000.0,7:F2}");
+            }
+        }
+
+        private void ConnectPeer(FakePeer peer, string host, int port)
+        {
+            Error error = peer.ConnectToServer(host, port);
+            if (error != Error.Ok)
+            {
+                GD.PrintErr($"{peer.Name} could not connect to {host}:{port}. Error code: {error}");
+                GetTree().Quit(-(int)error);
+            }
+        }
+
+        private void ParseArguments()
+        {
+            foreach (string argument in OS.GetCmdlineArgs())
+            {
+                if (!argument.StartsWith("--")) continue;
+
+                int separator = argument.IndexOf('=');
+                if (separator == -1) continue;
+
+                arguments[argument.Substring(2, separator - 2)] = argument.Substring(separator + 1);
+            }
+        }
+
+        private string GetArgument(string name, string @default)
+        {
+            return arguments.TryGetValue(name, out string value) ? value : @default;
+        }
+
+        private int GetArgument(string name, int @default)
+        {
+            return arguments.TryGetValue(name, out string value) && int.TryParse(value, out int result) ? result : @default;
+        }
+    }
+}
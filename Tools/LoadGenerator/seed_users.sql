@@ -0,0 +1,17 @@
+-- Inserts synthetic users load_user0..load_userN-1 with passwords load_password0..load_passwordN-1
+-- used by the load generator. Set @users to the `--users` value the generator is run with (at most 10000000).
+-- Numbers come from a cross join of digits, so it runs on MySQL and MariaDB alike.
+SET @users = 10000;
+
+CREATE TABLE load_digits (d INT NOT NULL PRIMARY KEY);
+INSERT INTO load_digits VALUES (0), (1), (2), (3), (4), (5), (6), (7), (8), (9);
+
+INSERT IGNORE INTO users (login, password)
+SELECT CONCAT('load_user', n), CONCAT('load_password', n)
+FROM (
+    SELECT d0.d + 10 * d1.d + 100 * d2.d + 1000 * d3.d + 10000 * d4.d + 100000 * d5.d + 1000000 * d6.d AS n
+    FROM load_digits d0, load_digits d1, load_digits d2, load_digits d3, load_digits d4, load_digits d5, load_digits d6
+) seq
+WHERE n < @users;
+
+DROP TABLE load_digits;